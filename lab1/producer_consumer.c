@@ -1,16 +1,36 @@
 // DVGB01 Lab 1 — Producer–Consumer (bounded buffer) med Pthreads
-// Windows-kompatibel (ingen sigwait/sigset_t). Avslut via Ctrl-C (SIGINT).
+// Windows-kompatibel (ingen sigwait/sigset_t). Avslut via Ctrl-C (SIGINT) eller SIGTERM.
+// På Linux väntar shutdown-watchern på signalfd/eventfd i stället för att polla.
 // Kompilera (MSYS2/MinGW):  gcc producer_consumer.c -o pc -lpthread
 // Kompilera (Linux/WSL):   gcc producer_consumer.c -o pc -pthread
-// Kör: ./pc N BufferSize TimeInterval
+// Kör: ./pc [-m mutex|spsc|mpmc] [-P Producers] [-b Batch] [-B PBatch]
+//           [-d Sekunder | -i Antal] [-C] [-L] [-v 0|1|2] [-D Millis] [-S Spin]
+//           N BufferSize TimeInterval
 // Ex:  ./pc 3 8 1
+//      ./pc -m spsc 1 1024 0   (låsfri ringbuffert, exakt en konsument)
+//      ./pc -m mpmc 8 1024 0   (låsfri ringbuffert, godtyckligt antal konsumenter)
+//      ./pc -b 32 3 1024 0     (konsumenter tömmer upp till 32 värden per hämtning)
+//      ./pc -B 16 3 1024 0     (producenten skriver 16 värden per reservation)
+//      ./pc -P 4 3 1024 0      (fyra producenter)
+//      ./pc -m mpmc -d 2 -C 4 1024 0   (benchmark i 2 s, resultat som CSV)
+//      ./pc -L 3 8 1           (mät kölatens, percentiler i summeringen)
+//      ./pc -v 1 3 1024 0      (ingen loggning per värde, bara start/stopp)
+//      ./pc -D 500 3 1024 1    (töm bufferten högst 500 ms efter Ctrl-C)
+//      ./pc -m mpmc -S 0 -d 2 4 64 0   (låsfri kö som parkerar direkt, utan spinn)
 
 #define _POSIX_C_SOURCE 200809L
+#ifdef __linux__
+  #define _DEFAULT_SOURCE   // syscall() för futex
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 
@@ -20,6 +40,13 @@
   static void sleep_millis(int ms) { if (ms > 0) Sleep((DWORD)ms); }
 #else
   #include <unistd.h>
+  #ifdef __linux__
+    #include <linux/futex.h>
+    #include <poll.h>
+    #include <sys/eventfd.h>
+    #include <sys/signalfd.h>
+    #include <sys/syscall.h>
+  #endif
   static void sleep_seconds(int s) {
       if (s <= 0) return;
       struct timespec req = { .tv_sec = s, .tv_nsec = 0 }, rem;
@@ -32,129 +59,981 @@
   }
 #endif
 
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#define CACHE_LINE 64
+
+// Ett värde i bufferten (64 bitar) bär producentens id i de övre bitarna och
+// producentens egen löpnummer i de nedre 48. Producent 0 ger alltså värdena
+// 1, 2, 3, ... och löpnumret slår inte runt under någon rimlig körning.
+#define ITEM_SEQ_BITS   48
+#define ITEM_SEQ_MASK   ((UINT64_C(1) << ITEM_SEQ_BITS) - 1)
+#define MAX_PRODUCERS   128
+#define ITEM_MAKE(p, s) (((uint64_t)(p) << ITEM_SEQ_BITS) | ((uint64_t)(s) & ITEM_SEQ_MASK))
+#define ITEM_PRODUCER(v) ((int)((v) >> ITEM_SEQ_BITS))
+#define ITEM_SEQ(v)      ((v) & ITEM_SEQ_MASK)
+
+// Ett element i bufferten är bara värdet. Tidsstämplarna för -L ligger i en
+// egen array (rb->stamps) som bara finns när latens mäts, så utan -L växer
+// varken bufferten eller kopieringen ut ur den.
+typedef uint64_t item_t;
+
+// --- Asynkron loggning -------------------------------------------------------
+// Trådarna formaterar aldrig text själva. Varje tråd skriver binära poster av
+// fast storlek i en egen låsfri SPSC-ring; en bakgrundstråd tömmer ringarna,
+// sorterar varje omgång på tidsstämpel, formaterar in i en stor buffert och
+// skriver den till stdout med en fwrite. Är ringen full väntar skrivaren in
+// loggtråden hellre än att tappa rader. När alla ringar är tomma parkerar
+// loggtråden på en condvar tills log_put eller log_stop väcker den.
+
+enum { LOG_QUIET = 0, LOG_EVENTS = 1, LOG_ITEMS = 2 };   // verbositet
+
+typedef enum {
+    LOG_PRODUCE,        // a = löpnummer, b = count
+    LOG_CONSUME,        // a = värde, b = count
+    LOG_PRODUCER_EXIT,
+    LOG_CONSUMER_EXIT,
+    LOG_SIGNAL          // a = signalnummer
+} log_kind_t;
+
+typedef struct {
+    uint64_t ts;
+    uint64_t a;
+    int kind;
+    int id;             // trådens id (producent/konsument)
+    int b;
+} log_rec_t;
+
+#define LOG_RING     4096   // poster per tråd (tvåpotens)
+#define LOG_OUT_SIZE (256 * 1024)
+
+typedef struct {
+    atomic_ulong tail;  // skrivs av ägartråden
+    char pad1[CACHE_LINE - sizeof(atomic_ulong)];
+    atomic_ulong head;  // skrivs av loggtråden
+    char pad2[CACHE_LINE - sizeof(atomic_ulong)];
+    log_rec_t recs[LOG_RING];
+} log_ring_t;
+
+typedef struct {
+    int level;
+    int producers;      // >1 -> producent-id skrivs ut
+    int nrings;
+    log_ring_t *rings;  // [0] = shutdown-watcher, sedan producenter och konsumenter
+    atomic_int stop;
+    atomic_int sleeping;    // loggtråden parkerar (eller är på väg att göra det)
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+    pthread_t thr;
+    char *out;
+} logger_t;
+
+static logger_t g_log;
+
+static void log_wake(void) {
+    pthread_mutex_lock(&g_log.mtx);
+    pthread_cond_signal(&g_log.cv);
+    pthread_mutex_unlock(&g_log.mtx);
+}
+
+static void log_put(log_ring_t *r, int kind, int id, uint64_t a, int b) {
+    unsigned long t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    while (t - atomic_load_explicit(&r->head, memory_order_acquire) == LOG_RING) sched_yield();
+    log_rec_t *rec = &r->recs[t & (LOG_RING - 1)];
+    rec->ts = now_ns();
+    rec->kind = kind;
+    rec->id = id;
+    rec->a = a;
+    rec->b = b;
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+    // Publicera tail före kontrollen av sleeping (motsvarande fence i log_main)
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&g_log.sleeping, memory_order_relaxed)) log_wake();
+}
+
+static int log_pending(void) {
+    for (int i = 0; i < g_log.nrings; ++i)
+        if (atomic_load_explicit(&g_log.rings[i].tail, memory_order_acquire) !=
+            atomic_load_explicit(&g_log.rings[i].head, memory_order_relaxed)) return 1;
+    return 0;
+}
+
+static int log_format(char *dst, size_t cap, const log_rec_t *rec) {
+    uint64_t v = rec->a;
+    switch (rec->kind) {
+        case LOG_PRODUCE:
+            if (g_log.producers > 1)
+                return snprintf(dst, cap, "[Producer %d] +%llu (count=%d)\n", rec->id, (unsigned long long)v, rec->b);
+            return snprintf(dst, cap, "[Producer] +%llu (count=%d)\n", (unsigned long long)v, rec->b);
+        case LOG_CONSUME:
+            if (g_log.producers > 1)
+                return snprintf(dst, cap, "  [Consumer %d] -%d:%llu (count=%d)\n", rec->id,
+                                ITEM_PRODUCER(v) + 1, (unsigned long long)ITEM_SEQ(v), rec->b);
+            return snprintf(dst, cap, "  [Consumer %d] -%llu (count=%d)\n", rec->id, (unsigned long long)v, rec->b);
+        case LOG_PRODUCER_EXIT:
+            if (g_log.producers > 1) return snprintf(dst, cap, "[Producer %d] Stänger.\n", rec->id);
+            return snprintf(dst, cap, "[Producer] Stänger.\n");
+        case LOG_CONSUMER_EXIT:
+            return snprintf(dst, cap, "  [Consumer %d] Stänger.\n", rec->id);
+        case LOG_SIGNAL:
+            return snprintf(dst, cap, "\n[Signal] %s mottagen. Påbörjar nedstängning...\n",
+                            rec->a == SIGTERM ? "SIGTERM" : "SIGINT");
+        default:
+            return 0;
+    }
+}
+
+// Tömmer allt som finns i ringarna just nu. Returnerar antal poster.
+static unsigned long log_drain(void) {
+    unsigned long heads[g_log.nrings], tails[g_log.nrings], total = 0;
+    for (int i = 0; i < g_log.nrings; ++i) {
+        heads[i] = atomic_load_explicit(&g_log.rings[i].head, memory_order_relaxed);
+        tails[i] = atomic_load_explicit(&g_log.rings[i].tail, memory_order_acquire);
+    }
+    size_t used = 0;
+    for (;;) {
+        // Äldsta posten bland ringarnas huvuden
+        int best = -1;
+        uint64_t best_ts = 0;
+        for (int i = 0; i < g_log.nrings; ++i) {
+            if (heads[i] == tails[i]) continue;
+            uint64_t ts = g_log.rings[i].recs[heads[i] & (LOG_RING - 1)].ts;
+            if (best < 0 || ts < best_ts) { best = i; best_ts = ts; }
+        }
+        if (best < 0) break;
+
+        if (LOG_OUT_SIZE - used < 256) { fwrite(g_log.out, 1, used, stdout); used = 0; }
+        used += log_format(g_log.out + used, LOG_OUT_SIZE - used,
+                           &g_log.rings[best].recs[heads[best] & (LOG_RING - 1)]);
+        heads[best]++;
+        total++;
+        // Frigör platser löpande så att skrivaren inte väntar på hela omgången
+        if ((heads[best] & 255) == 0)
+            atomic_store_explicit(&g_log.rings[best].head, heads[best], memory_order_release);
+    }
+    for (int i = 0; i < g_log.nrings; ++i)
+        atomic_store_explicit(&g_log.rings[i].head, heads[i], memory_order_release);
+    if (used) { fwrite(g_log.out, 1, used, stdout); fflush(stdout); }
+    return total;
+}
+
+static void *log_main(void *arg) {
+    (void)arg;
+    while (!atomic_load(&g_log.stop)) {
+        if (log_drain() > 0) continue;
+        // Tomt: parkera. sleeping sätts före sista kontrollen av ringarna och
+        // log_put skriver tail före sin kontroll av sleeping, så med fencarna
+        // ser minst en av sidorna den andra (ingen förlorad väckning).
+        pthread_mutex_lock(&g_log.mtx);
+        atomic_store(&g_log.sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (!log_pending() && !atomic_load(&g_log.stop)) pthread_cond_wait(&g_log.cv, &g_log.mtx);
+        atomic_store(&g_log.sleeping, 0);
+        pthread_mutex_unlock(&g_log.mtx);
+    }
+    log_drain();
+    return NULL;
+}
+
+static void log_start(int level, int producers, int nrings) {
+    g_log.level = level;
+    g_log.producers = producers;
+    g_log.nrings = nrings;
+    g_log.rings = (log_ring_t*)calloc(nrings, sizeof(log_ring_t));
+    g_log.out = (char*)malloc(LOG_OUT_SIZE);
+    if (!g_log.rings || !g_log.out) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < nrings; ++i) {
+        atomic_init(&g_log.rings[i].tail, 0);
+        atomic_init(&g_log.rings[i].head, 0);
+    }
+    atomic_init(&g_log.stop, 0);
+    atomic_init(&g_log.sleeping, 0);
+    if (pthread_mutex_init(&g_log.mtx, NULL) != 0 || pthread_cond_init(&g_log.cv, NULL) != 0) {
+        perror("pthread_mutex_init/pthread_cond_init logger");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&g_log.thr, NULL, log_main, NULL) != 0) {
+        perror("pthread_create logger");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Väntar tills loggtråden skrivit ut allt och stänger den
+static void log_stop(void) {
+    atomic_store(&g_log.stop, 1);
+    log_wake();
+    pthread_join(g_log.thr, NULL);
+    pthread_cond_destroy(&g_log.cv);
+    pthread_mutex_destroy(&g_log.mtx);
+    free(g_log.rings);
+    free(g_log.out);
+}
+
+// --- Adaptiv väntan för de låsfria lägena -----------------------------------
+// En tråd som hittar bufferten tom/full spinner först (med pause), ger sedan
+// bort tidsskivan några gånger och parkerar till sist: på Linux med en futex,
+// annars på condvaren. Spinnbudgeten justeras efter hur länge väntan faktiskt
+// brukar vara: löses den under spinnet siktar vi på dubbla den tiden, krävs
+// parkering halveras budgeten. På en enprocessormaskin kan motparten inte köra
+// medan vi spinner, så där är standardbudgeten 0.
+
+#define SPIN_DEFAULT 2000   // max antal spinnvarv (-S)
+#define SPIN_MIN     16
+#define WAIT_YIELDS  4
+
+typedef struct {
+    // Eventcount för futexen: ökas vid varje väckning. Den som ska parkera
+    // läser värdet innan den kontrollerar villkoret, så en väckning mellan
+    // kontroll och futex_wait gör att futex_wait returnerar direkt.
+    _Alignas(CACHE_LINE) atomic_uint futex;
+    atomic_int waiters;     // trådar i parkeringsfasen
+    atomic_int spin;        // aktuell spinnbudget
+    atomic_ulong parks;     // antal parkeringar (statistik)
+    pthread_cond_t *cv;     // parkering utanför Linux
+} waitq_t;
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static int online_cpus(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 2;   // okänt: anta flerprocessor
+#endif
+}
+
+#ifdef __linux__
+static void futex_wait(atomic_uint *addr, unsigned int val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint *addr, int n) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+#endif
+
+// Backend för ringbufferten. RB_MUTEX är referensen (mutex + condvars),
+// RB_SPSC är låsfri för exakt en producent och en konsument, RB_MPMC är en
+// begränsad låsfri kö (Vyukov) med sekvensnummer per plats.
+typedef enum { RB_MUTEX, RB_SPSC, RB_MPMC } rb_mode_t;
+
 typedef struct {
-    int *data;
+    rb_mode_t mode;
+    item_t *data;
+    uint64_t *stamps;   // tidsstämpel per plats (CLOCK_MONOTONIC, ns), NULL utan -L
     int size;
     int head;   // dequeue
     int tail;   // enqueue
     int count;
 
+    // Låsfria lägen: monotona räknare (index = räknare % size). De är 64 bitar
+    // även där unsigned long är 32 (MinGW): ett varv runt 2^32 hoppar annars
+    // till fel plats när size inte är en tvåpotens.
+    // SPSC: lf_tail skrivs bara av producenten och lf_head bara av konsumenten;
+    // var sida cachar den andras senast lästa värde så att delade cache-rader
+    // bara läses vid behov.
+    // MPMC: trådarna gör anspråk på en position med CAS på lf_tail/lf_head.
+    // seq[i] == pos betyder ledig för producenten av pos, seq[i] == pos+1
+    // betyder ifylld och redo för konsumenten av pos.
+    _Atomic uint64_t *seq;
+    _Alignas(CACHE_LINE) _Atomic uint64_t lf_tail;
+    uint64_t prod_head_cache;
+    _Alignas(CACHE_LINE) _Atomic uint64_t lf_head;
+    uint64_t cons_tail_cache;
+
+    // Väntköer för de låsfria lägena (konsumenter resp. producenter)
+    waitq_t wq_not_empty;
+    waitq_t wq_not_full;
+    int spin_max;
+    _Alignas(CACHE_LINE) atomic_int producers_active;
+
     pthread_mutex_t mtx;
     pthread_cond_t  not_empty;
     pthread_cond_t  not_full;
 
-    int shutdown; // 0=running, 1=stäng ner
-    unsigned long produced_total;
-    unsigned long consumed_total;
+    atomic_int shutdown; // 0=running, 1=stäng ner
+    atomic_int drain_abort;      // 1 = tömningsfristen har gått ut, konsumenterna slutar direkt
+    atomic_int consumers_active;
+    pthread_cond_t drained;      // signaleras när sista konsumenten avslutat
+    pthread_cond_t stopped;      // broadcast:as när shutdown sätts (se rb_wake_all)
+    atomic_ulong produced_total;
+    atomic_ulong consumed_total;
+    atomic_ulong discarded_total; // uttagna men aldrig behandlade när tömningsfristen gick ut
 } ring_buffer_t;
 
+// Reserverade, sammanhängande platser i bufferten. Producenten skriver
+// direkt i slots[0..n-1] och publicerar dem sedan med rb_commit.
+typedef struct {
+    item_t *slots;
+    uint64_t *stamps;   // motsvarande tidsstämplar, NULL utan -L
+    int n;
+    int count;          // antal element i bufferten vid reservationen
+    uint64_t pos;       // startposition (låsfria lägen)
+} rb_span_t;
+
+// Log-linjärt (HDR-liknande) histogram över latenser i ns: värden under
+// HIST_SUB räknas exakt, därefter delas varje tvåpotens i HIST_SUB lika
+// stora hinkar (relativt fel under 1/HIST_SUB). Ett histogram per tråd,
+// slås ihop vid avslut.
+#define HIST_SUB_BITS 5
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    unsigned long counts[HIST_BUCKETS];
+    unsigned long total;
+    uint64_t max;
+} hist_t;
+
+static int hist_index(uint64_t v) {
+    if (v < HIST_SUB) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+}
+
+// Största värde som hamnar i hink idx
+static uint64_t hist_value(int idx) {
+    if (idx < HIST_SUB) return (uint64_t)idx;
+    int shift = idx / HIST_SUB - 1;
+    uint64_t base = (uint64_t)(idx % HIST_SUB + HIST_SUB) << shift;
+    return base + ((uint64_t)1 << shift) - 1;
+}
+
+static void hist_record(hist_t *h, uint64_t v) {
+    h->counts[hist_index(v)]++;
+    h->total++;
+    if (v > h->max) h->max = v;
+}
+
+static void hist_merge(hist_t *dst, const hist_t *src) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static uint64_t hist_percentile(const hist_t *h, double q) {
+    if (h->total == 0) return 0;
+    double r = q * (double)h->total;
+    unsigned long rank = (unsigned long)r;
+    if ((double)rank < r) rank++;   // avrunda uppåt
+    if (rank < 1) rank = 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
 typedef struct {
     int id;
     ring_buffer_t *rb;
     int time_interval; // sekunder (används av producent)
+    int batch;         // max antal värden per hämtning/reservation
+    int producers;     // antal producenter (styr hur värden skrivs ut)
+    int bench;         // benchmarkläge: inga sömnar, ingen utskrift per värde
+    unsigned long quota; // benchmark: antal värden att producera (0 = obegränsat)
+    unsigned long count; // antal producerade/konsumerade värden (per tråd)
+    int latency;       // stämpla/mät kölatens
+    hist_t *hist;      // konsument: kölatens (endast om latency)
+    log_ring_t *log;   // trådens loggring
 } thread_arg_t;
 
-// Global flagga som sätts av signal-handlern
+// Väcker alla som väntar, oavsett läge (anropas efter att shutdown eller
+// drain_abort har satts)
+static void rb_wake_all(ring_buffer_t *rb) {
+    pthread_cond_broadcast(&rb->not_empty);
+    pthread_cond_broadcast(&rb->not_full);
+    pthread_cond_broadcast(&rb->stopped);
+#ifdef __linux__
+    atomic_fetch_add(&rb->wq_not_empty.futex, 1);
+    futex_wake(&rb->wq_not_empty.futex, INT_MAX);
+    atomic_fetch_add(&rb->wq_not_full.futex, 1);
+    futex_wake(&rb->wq_not_full.futex, INT_MAX);
+#endif
+}
+
+// Global flagga som sätts vid stopp: signalnumret, eller -1 för ett internt
+// stopp (t.ex. när benchmarken är klar)
 static volatile sig_atomic_t g_stop_flag = 0;
 
-static void handle_sigint(int sig) {
-    (void)sig;
-    g_stop_flag = 1;
+#ifdef __linux__
+// SIGINT/SIGTERM blockeras i alla trådar och levereras via signalfd; interna
+// stopp skrivs till eventfd. Watchern sover i poll() tills något händer.
+static int g_signal_fd = -1;
+static int g_event_fd = -1;
+
+static void stop_events_init(void) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    // Före alla pthread_create så att ingen tråd ärver en oblockerad mask
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) { perror("pthread_sigmask"); exit(EXIT_FAILURE); }
+    g_signal_fd = signalfd(-1, &set, SFD_CLOEXEC);
+    g_event_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_signal_fd < 0 || g_event_fd < 0) { perror("signalfd/eventfd"); exit(EXIT_FAILURE); }
 }
 
-// Tråd: väntar tills g_stop_flag=1, sätter rb->shutdown och broadcast:ar
-static void *shutdown_watcher(void *arg) {
-    ring_buffer_t *rb = (ring_buffer_t*)arg;
+static void stop_events_close(void) {
+    close(g_signal_fd);
+    close(g_event_fd);
+}
+
+static void wait_for_stop(void) {
+    struct pollfd fds[2] = { { .fd = g_signal_fd, .events = POLLIN }, { .fd = g_event_fd, .events = POLLIN } };
+    while (!g_stop_flag) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            g_stop_flag = -1;
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            struct signalfd_siginfo si;
+            if (read(g_signal_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) g_stop_flag = (int)si.ssi_signo;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t v;
+            if (read(g_event_fd, &v, sizeof(v)) < 0) perror("read eventfd");
+        }
+    }
+}
+
+static void request_stop(void) {
+    uint64_t one = 1;
+    g_stop_flag = -1;
+    if (write(g_event_fd, &one, sizeof(one)) < 0) perror("write eventfd");
+}
+#else
+static void handle_signal(int sig) {
+    g_stop_flag = sig;
+}
+
+static void stop_events_init(void) {
+    // Installera signalhanterare (finns i både Windows/MinGW och Linux)
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+}
+
+static void stop_events_close(void) {}
+
+static void wait_for_stop(void) {
     while (!g_stop_flag) {
         // Sov lite för att inte spinna (10 ms)
         sleep_millis(10);
     }
+}
+
+static void request_stop(void) {
+    g_stop_flag = -1;
+}
+#endif
+
+typedef struct {
+    ring_buffer_t *rb;
+    int drain_ms;      // <0 = töm bufferten utan tidsgräns
+} watcher_arg_t;
+
+// Absolut tidpunkt ms millisekunder fram, för pthread_cond_timedwait
+static void deadline_after_ms(struct timespec *ts, long ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec  += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) { ts->tv_sec++; ts->tv_nsec -= 1000000000L; }
+}
+
+// Tråd: väntar tills stopp begärs, sätter rb->shutdown och broadcast:ar.
+// Med tömningsfrist väntar den sedan in konsumenterna högst drain_ms ms och
+// avbryter därefter tömningen.
+static void *shutdown_watcher(void *arg) {
+    watcher_arg_t *warg = (watcher_arg_t*)arg;
+    ring_buffer_t *rb = warg->rb;
+    wait_for_stop();
+
     pthread_mutex_lock(&rb->mtx);
     if (!rb->shutdown) {
         rb->shutdown = 1;
-        printf("\n[Signal] SIGINT mottagen. Påbörjar nedstängning...\n");
-        pthread_cond_broadcast(&rb->not_empty);
-        pthread_cond_broadcast(&rb->not_full);
+        if (g_log.level >= LOG_EVENTS) log_put(&g_log.rings[0], LOG_SIGNAL, 0, g_stop_flag, 0);
+        rb_wake_all(rb);
+    }
+
+    if (warg->drain_ms >= 0) {
+        struct timespec deadline;
+        deadline_after_ms(&deadline, warg->drain_ms);
+        while (atomic_load(&rb->consumers_active) > 0) {
+            if (pthread_cond_timedwait(&rb->drained, &rb->mtx, &deadline) == ETIMEDOUT) break;
+        }
+        if (atomic_load(&rb->consumers_active) > 0) {
+            rb->drain_abort = 1;
+            rb_wake_all(rb);
+        }
     }
     pthread_mutex_unlock(&rb->mtx);
     return NULL;
 }
 
-static void rb_init(ring_buffer_t *rb, int size) {
-    rb->data  = (int*)malloc(sizeof(int) * size);
+// Sätter shutdown och väcker alla som väntar
+static void rb_shutdown(ring_buffer_t *rb) {
+    pthread_mutex_lock(&rb->mtx);
+    rb->shutdown = 1;
+    rb_wake_all(rb);
+    pthread_mutex_unlock(&rb->mtx);
+}
+
+// Väntar tills shutdown sätts (signal eller internt stopp), men högst ms ms
+static void rb_wait_shutdown(ring_buffer_t *rb, long ms) {
+    struct timespec deadline;
+    deadline_after_ms(&deadline, ms);
+    pthread_mutex_lock(&rb->mtx);
+    while (!rb->shutdown)
+        if (pthread_cond_timedwait(&rb->stopped, &rb->mtx, &deadline) == ETIMEDOUT) break;
+    pthread_mutex_unlock(&rb->mtx);
+}
+
+static void waitq_init(waitq_t *q, pthread_cond_t *cv, int spin_max) {
+    atomic_init(&q->futex, 0);
+    atomic_init(&q->waiters, 0);
+    atomic_init(&q->spin, spin_max);
+    atomic_init(&q->parks, 0);
+    q->cv = cv;
+}
+
+static void rb_init(ring_buffer_t *rb, int size, rb_mode_t mode, int spin_max, int latency) {
+    rb->data  = (item_t*)malloc(sizeof(item_t) * size);
     if (!rb->data) { perror("malloc"); exit(EXIT_FAILURE); }
+    rb->stamps = NULL;
+    if (latency) {
+        rb->stamps = (uint64_t*)malloc(sizeof(uint64_t) * size);
+        if (!rb->stamps) { perror("malloc"); exit(EXIT_FAILURE); }
+    }
+    rb->mode  = mode;
     rb->size  = size;
     rb->head  = 0;
     rb->tail  = 0;
     rb->count = 0;
-    rb->shutdown = 0;
+    rb->seq = NULL;
+    if (mode == RB_MPMC) {
+        rb->seq = (_Atomic uint64_t*)malloc(sizeof(_Atomic uint64_t) * size);
+        if (!rb->seq) { perror("malloc"); exit(EXIT_FAILURE); }
+        for (int i = 0; i < size; ++i) atomic_init(&rb->seq[i], (uint64_t)i);
+    }
+    atomic_init(&rb->lf_tail, 0);
+    atomic_init(&rb->lf_head, 0);
+    rb->prod_head_cache = 0;
+    rb->cons_tail_cache = 0;
+    rb->spin_max = spin_max;
+    waitq_init(&rb->wq_not_empty, &rb->not_empty, spin_max);
+    waitq_init(&rb->wq_not_full, &rb->not_full, spin_max);
+    atomic_init(&rb->producers_active, 0);
+    atomic_init(&rb->shutdown, 0);
+    atomic_init(&rb->drain_abort, 0);
+    atomic_init(&rb->consumers_active, 0);
     rb->produced_total = 0;
     rb->consumed_total = 0;
+    rb->discarded_total = 0;
 
     if (pthread_mutex_init(&rb->mtx, NULL) != 0) { perror("pthread_mutex_init"); exit(EXIT_FAILURE); }
     if (pthread_cond_init(&rb->not_empty, NULL) != 0) { perror("pthread_cond_init not_empty"); exit(EXIT_FAILURE); }
     if (pthread_cond_init(&rb->not_full, NULL) != 0)  { perror("pthread_cond_init not_full");  exit(EXIT_FAILURE); }
+    if (pthread_cond_init(&rb->drained, NULL) != 0)   { perror("pthread_cond_init drained");   exit(EXIT_FAILURE); }
+    if (pthread_cond_init(&rb->stopped, NULL) != 0)   { perror("pthread_cond_init stopped");   exit(EXIT_FAILURE); }
 }
 
 static void rb_destroy(ring_buffer_t *rb) {
     pthread_cond_destroy(&rb->not_empty);
     pthread_cond_destroy(&rb->not_full);
+    pthread_cond_destroy(&rb->drained);
+    pthread_cond_destroy(&rb->stopped);
     pthread_mutex_destroy(&rb->mtx);
+    free(rb->seq);
+    free(rb->stamps);
     free(rb->data);
 }
 
-static int rb_enqueue(ring_buffer_t *rb, int value) {
-    rb->data[rb->tail] = value;
-    rb->tail = (rb->tail + 1) % rb->size;
-    rb->count++;
-    rb->produced_total++;
-    return 0;
+// Mutex-läge: reserverar upp till n lediga platser från tail, utan att passera
+// buffertens slut. Returnerar antalet med rb->mtx låst, eller -1 (olåst) vid
+// shutdown. rb_commit_mutex publicerar och släpper låset.
+static int rb_reserve_mutex(ring_buffer_t *rb, int n, rb_span_t *sp) {
+    pthread_mutex_lock(&rb->mtx);
+    if (rb->shutdown) { pthread_mutex_unlock(&rb->mtx); return -1; }
+
+    while (rb->count == rb->size && !rb->shutdown) {
+        pthread_cond_wait(&rb->not_full, &rb->mtx);
+    }
+    if (rb->shutdown) { pthread_mutex_unlock(&rb->mtx); return -1; }
+
+    int room = rb->size - rb->count;
+    int contiguous = rb->size - rb->tail;
+    if (n > room) n = room;
+    if (n > contiguous) n = contiguous;
+    sp->slots = &rb->data[rb->tail];
+    sp->stamps = rb->stamps ? &rb->stamps[rb->tail] : NULL;
+    sp->n = n;
+    sp->count = rb->count;
+    sp->pos = (uint64_t)rb->tail;
+    return n;
 }
 
-static int rb_dequeue(ring_buffer_t *rb, int *out) {
-    *out = rb->data[rb->head];
-    rb->head = (rb->head + 1) % rb->size;
-    rb->count--;
-    rb->consumed_total++;
-    return 0;
+static void rb_commit_mutex(ring_buffer_t *rb, const rb_span_t *sp) {
+    rb->tail = (rb->tail + sp->n) % rb->size;
+    rb->count += sp->n;
+    rb->produced_total += sp->n;
+    if (sp->n > 1) pthread_cond_broadcast(&rb->not_empty);
+    else           pthread_cond_signal(&rb->not_empty);
+    pthread_mutex_unlock(&rb->mtx);
+}
+
+// Kopierar n värden från position start, i högst två sammanhängande segment.
+// Tidsstämplarna kopieras bara om stamps_out ges (kräver rb->stamps).
+static void rb_copy_out(const ring_buffer_t *rb, int start, item_t *out, uint64_t *stamps_out, int n) {
+    int first = rb->size - start;
+    if (first > n) first = n;
+    memcpy(out, &rb->data[start], sizeof(item_t) * first);
+    memcpy(out + first, rb->data, sizeof(item_t) * (n - first));
+    if (stamps_out) {
+        memcpy(stamps_out, &rb->stamps[start], sizeof(uint64_t) * first);
+        memcpy(stamps_out + first, rb->stamps, sizeof(uint64_t) * (n - first));
+    }
+}
+
+// Tar ut upp till max värden under ett och samma lås. Returnerar antalet.
+static int rb_dequeue_batch(ring_buffer_t *rb, item_t *out, uint64_t *stamps_out, int max) {
+    int n = rb->count < max ? rb->count : max;
+    rb_copy_out(rb, rb->head, out, stamps_out, n);
+    rb->head = (rb->head + n) % rb->size;
+    rb->count -= n;
+    rb->consumed_total += n;
+    return n;
+}
+
+// Antal element i bufferten (i låsfria lägen en ögonblicksbild)
+static int rb_count(ring_buffer_t *rb) {
+    if (rb->mode == RB_MUTEX) return rb->count;
+    return (int)(atomic_load(&rb->lf_tail) - atomic_load(&rb->lf_head));
+}
+
+// --- Blockering för de låsfria lägena ---------------------------------------
+// Den snabba vägen rör aldrig mutexen eller futexen. Bara när bufferten
+// verkligen är tom/full går tråden in i lf_block (spinn, yield, parkering).
+// Parkeraren registrerar sig i waiters innan den kontrollerar villkoret;
+// väckaren publicerar först sitt index och kontrollerar sedan waiters.
+// seq_cst-fencarna på båda sidor garanterar att minst en av dem ser den
+// andras skrivning (ingen förlorad väckning).
+
+static int spsc_can_get(ring_buffer_t *rb) {
+    return atomic_load_explicit(&rb->lf_tail, memory_order_acquire) !=
+           atomic_load_explicit(&rb->lf_head, memory_order_relaxed) ||
+           (rb->shutdown && atomic_load(&rb->producers_active) == 0) || rb->drain_abort;
+}
+
+static int spsc_can_put(ring_buffer_t *rb) {
+    return atomic_load_explicit(&rb->lf_tail, memory_order_relaxed) -
+           atomic_load_explicit(&rb->lf_head, memory_order_acquire) < (uint64_t)rb->size ||
+           rb->shutdown;
+}
+
+// Flyttar spinnbudgeten en åttondel mot target, inom [SPIN_MIN, spin_max]
+static void waitq_adapt(ring_buffer_t *rb, waitq_t *q, int target) {
+    int lo = rb->spin_max < SPIN_MIN ? rb->spin_max : SPIN_MIN;
+    int cur = atomic_load_explicit(&q->spin, memory_order_relaxed);
+    int next = cur + (target - cur) / 8;
+    if (next < lo) next = lo;
+    if (next > rb->spin_max) next = rb->spin_max;
+    atomic_store_explicit(&q->spin, next, memory_order_relaxed);
+}
+
+static void lf_block(ring_buffer_t *rb, waitq_t *q, int (*ready)(ring_buffer_t*)) {
+    int budget = atomic_load_explicit(&q->spin, memory_order_relaxed);
+    for (int i = 0; i < budget; ++i) {
+        if (ready(rb)) { waitq_adapt(rb, q, 2 * i); return; }
+        cpu_relax();
+    }
+    for (int i = 0; rb->spin_max > 0 && i < WAIT_YIELDS; ++i) {
+        sched_yield();
+        if (ready(rb)) { waitq_adapt(rb, q, 2 * budget); return; }
+    }
+    waitq_adapt(rb, q, budget / 2);
+    atomic_fetch_add_explicit(&q->parks, 1, memory_order_relaxed);
+
+#ifdef __linux__
+    atomic_fetch_add(&q->waiters, 1);
+    for (;;) {
+        unsigned int key = atomic_load(&q->futex);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ready(rb)) break;
+        futex_wait(&q->futex, key);
+    }
+    atomic_fetch_sub(&q->waiters, 1);
+#else
+    pthread_mutex_lock(&rb->mtx);
+    atomic_fetch_add(&q->waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!ready(rb)) pthread_cond_wait(q->cv, &rb->mtx);
+    atomic_fetch_sub(&q->waiters, 1);
+    pthread_mutex_unlock(&rb->mtx);
+#endif
+}
+
+// Väcker upp till n parkerade trådar (n = antal nyss publicerade/frigjorda platser)
+static void lf_wake(ring_buffer_t *rb, waitq_t *q, int n) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->waiters, memory_order_relaxed) == 0) return;
+#ifdef __linux__
+    (void)rb;
+    atomic_fetch_add(&q->futex, 1);
+    futex_wake(&q->futex, n);
+#else
+    (void)n;
+    pthread_mutex_lock(&rb->mtx);
+    pthread_cond_broadcast(q->cv);
+    pthread_mutex_unlock(&rb->mtx);
+#endif
+}
+
+// SPSC: reserverar upp till n sammanhängande lediga platser. Returnerar
+// antalet (>=1), eller -1 vid shutdown.
+static int spsc_reserve(ring_buffer_t *rb, int n, rb_span_t *sp) {
+    uint64_t size = (uint64_t)rb->size;
+    uint64_t t = atomic_load_explicit(&rb->lf_tail, memory_order_relaxed);
+    while (t - rb->prod_head_cache >= size) {
+        rb->prod_head_cache = atomic_load_explicit(&rb->lf_head, memory_order_acquire);
+        if (t - rb->prod_head_cache < size) break;
+        if (rb->shutdown) return -1;
+        lf_block(rb, &rb->wq_not_full, spsc_can_put);
+    }
+    if (atomic_load_explicit(&rb->shutdown, memory_order_relaxed)) return -1;
+
+    uint64_t room = size - (t - rb->prod_head_cache);
+    uint64_t contiguous = size - t % size;
+    if ((uint64_t)n > room) n = (int)room;
+    if ((uint64_t)n > contiguous) n = (int)contiguous;
+    sp->slots = &rb->data[t % size];
+    sp->stamps = rb->stamps ? &rb->stamps[t % size] : NULL;
+    sp->n = n;
+    sp->count = (int)(t - rb->prod_head_cache);
+    sp->pos = t;
+    return n;
+}
+
+// SPSC: publicerar hela reservationen med en enda release-skrivning
+static void spsc_commit(ring_buffer_t *rb, const rb_span_t *sp) {
+    atomic_store_explicit(&rb->lf_tail, sp->pos + sp->n, memory_order_release);
+    atomic_fetch_add_explicit(&rb->produced_total, sp->n, memory_order_relaxed);
+    lf_wake(rb, &rb->wq_not_empty, sp->n);
+}
+
+// SPSC: ta ut upp till max värden. Returnerar antalet (>=1), eller -1 när
+// shutdown är satt, producenten har avslutat och bufferten är tömd.
+static int spsc_get(ring_buffer_t *rb, item_t *out, uint64_t *stamps_out, int max, int *count_out) {
+    uint64_t h = atomic_load_explicit(&rb->lf_head, memory_order_relaxed);
+    while (rb->cons_tail_cache == h) {
+        rb->cons_tail_cache = atomic_load_explicit(&rb->lf_tail, memory_order_acquire);
+        if (rb->cons_tail_cache != h) break;
+        if (rb->drain_abort) return -1;
+        if (rb->shutdown && atomic_load(&rb->producers_active) == 0) {
+            // Sista kontroll: producenten kan ha publicerat innan den avslutade
+            rb->cons_tail_cache = atomic_load_explicit(&rb->lf_tail, memory_order_acquire);
+            if (rb->cons_tail_cache == h) return -1;
+            break;
+        }
+        lf_block(rb, &rb->wq_not_empty, spsc_can_get);
+    }
+
+    int n = (int)(rb->cons_tail_cache - h);
+    if (n > max) n = max;
+    rb_copy_out(rb, (int)(h % (uint64_t)rb->size), out, stamps_out, n);
+    atomic_store_explicit(&rb->lf_head, h + n, memory_order_release);
+    atomic_fetch_add_explicit(&rb->consumed_total, n, memory_order_relaxed);
+    if (count_out) *count_out = (int)(rb->cons_tail_cache - (h + n));
+    lf_wake(rb, &rb->wq_not_full, n);
+    return n;
+}
+
+static int mpmc_can_put(ring_buffer_t *rb) {
+    uint64_t pos = atomic_load_explicit(&rb->lf_tail, memory_order_relaxed);
+    return atomic_load_explicit(&rb->seq[pos % (uint64_t)rb->size], memory_order_acquire) == pos ||
+           rb->shutdown;
+}
+
+static int mpmc_can_get(ring_buffer_t *rb) {
+    uint64_t pos = atomic_load_explicit(&rb->lf_head, memory_order_relaxed);
+    return atomic_load_explicit(&rb->seq[pos % (uint64_t)rb->size], memory_order_acquire) == pos + 1 ||
+           (rb->shutdown && atomic_load(&rb->producers_active) == 0) || rb->drain_abort;
+}
+
+// MPMC: reserverar upp till n sammanhängande lediga platser med en CAS på
+// lf_tail. Returnerar antalet (>=1), eller -1 vid shutdown. Platserna syns
+// inte för konsumenterna förrän mpmc_commit har skrivit deras sekvensnummer.
+static int mpmc_reserve(ring_buffer_t *rb, int n, rb_span_t *sp) {
+    uint64_t size = (uint64_t)rb->size;
+    for (;;) {
+        if (atomic_load_explicit(&rb->shutdown, memory_order_relaxed)) return -1;
+        uint64_t pos = atomic_load_explicit(&rb->lf_tail, memory_order_relaxed);
+        uint64_t sq  = atomic_load_explicit(&rb->seq[pos % size], memory_order_acquire);
+        int64_t diff = (int64_t)(sq - pos);
+        if (diff == 0) {
+            uint64_t contiguous = size - pos % size;
+            int k = 1;
+            while (k < n && (uint64_t)k < contiguous &&
+                   atomic_load_explicit(&rb->seq[(pos + k) % size], memory_order_acquire) == pos + k)
+                k++;
+            if (!atomic_compare_exchange_weak_explicit(&rb->lf_tail, &pos, pos + k,
+                                                       memory_order_relaxed, memory_order_relaxed))
+                continue;
+            sp->slots = &rb->data[pos % size];
+            sp->stamps = rb->stamps ? &rb->stamps[pos % size] : NULL;
+            sp->n = k;
+            sp->count = (int)(pos - atomic_load_explicit(&rb->lf_head, memory_order_relaxed));
+            sp->pos = pos;
+            return k;
+        }
+        // diff < 0: platsen innehåller fortfarande ett varv gammalt värde -> full
+        // diff > 0: en annan producent hann före, försök igen
+        if (diff < 0) lf_block(rb, &rb->wq_not_full, mpmc_can_put);
+    }
+}
+
+// MPMC: publicerar hela reservationen och väcker konsumenterna en gång
+static void mpmc_commit(ring_buffer_t *rb, const rb_span_t *sp) {
+    uint64_t size = (uint64_t)rb->size;
+    for (int i = 0; i < sp->n; ++i)
+        atomic_store_explicit(&rb->seq[(sp->pos + i) % size], sp->pos + i + 1, memory_order_release);
+    atomic_fetch_add_explicit(&rb->produced_total, sp->n, memory_order_relaxed);
+    lf_wake(rb, &rb->wq_not_empty, sp->n);
+}
+
+// MPMC: ta ut upp till max värden. Returnerar antalet (>=1), eller -1 när
+// shutdown är satt, alla producenter har avslutat och bufferten är tömd.
+// Alla redo platser i följd från head tas i anspråk med en enda CAS.
+static int mpmc_get(ring_buffer_t *rb, item_t *out, uint64_t *stamps_out, int max, int *count_out) {
+    uint64_t size = (uint64_t)rb->size;
+    for (;;) {
+        uint64_t pos = atomic_load_explicit(&rb->lf_head, memory_order_relaxed);
+        uint64_t sq  = atomic_load_explicit(&rb->seq[pos % size], memory_order_acquire);
+        int64_t diff = (int64_t)(sq - (pos + 1));
+        if (diff == 0) {
+            int n = 1;
+            while (n < max && (uint64_t)n < size &&
+                   atomic_load_explicit(&rb->seq[(pos + n) % size], memory_order_acquire) == pos + n + 1)
+                n++;
+            if (!atomic_compare_exchange_weak_explicit(&rb->lf_head, &pos, pos + n,
+                                                       memory_order_relaxed, memory_order_relaxed))
+                continue;
+            rb_copy_out(rb, (int)(pos % size), out, stamps_out, n);
+            for (int i = 0; i < n; ++i)
+                atomic_store_explicit(&rb->seq[(pos + i) % size], pos + i + size, memory_order_release);
+            atomic_fetch_add_explicit(&rb->consumed_total, n, memory_order_relaxed);
+            if (count_out) *count_out = (int)(atomic_load_explicit(&rb->lf_tail, memory_order_relaxed) - (pos + n));
+            lf_wake(rb, &rb->wq_not_full, n);
+            return n;
+        }
+        if (diff < 0) {
+            if (rb->drain_abort) return -1;
+            if (rb->shutdown && atomic_load(&rb->producers_active) == 0) {
+                // Alla publiceringar syns nu; tom även efter omläsning -> klart
+                sq = atomic_load_explicit(&rb->seq[pos % size], memory_order_acquire);
+                if ((int64_t)(sq - (pos + 1)) < 0) return -1;
+                continue;
+            }
+            lf_block(rb, &rb->wq_not_empty, mpmc_can_get);
+        }
+    }
+}
+
+// Reserverar upp till n sammanhängande platser i valt läge (se rb_span_t).
+// Måste alltid följas av rb_commit när returvärdet är >= 1.
+static int rb_reserve(ring_buffer_t *rb, int n, rb_span_t *sp) {
+    switch (rb->mode) {
+        case RB_SPSC: return spsc_reserve(rb, n, sp);
+        case RB_MPMC: return mpmc_reserve(rb, n, sp);
+        default:      return rb_reserve_mutex(rb, n, sp);
+    }
+}
+
+static void rb_commit(ring_buffer_t *rb, const rb_span_t *sp) {
+    switch (rb->mode) {
+        case RB_SPSC: spsc_commit(rb, sp); break;
+        case RB_MPMC: mpmc_commit(rb, sp); break;
+        default:      rb_commit_mutex(rb, sp); break;
+    }
+}
+
+static int lf_get(ring_buffer_t *rb, item_t *out, uint64_t *stamps_out, int max, int *count_out) {
+    return rb->mode == RB_SPSC ? spsc_get(rb, out, stamps_out, max, count_out)
+                               : mpmc_get(rb, out, stamps_out, max, count_out);
 }
 
 static void *producer_main(void *arg) {
     thread_arg_t *targ = (thread_arg_t*)arg;
     ring_buffer_t *rb = targ->rb;
     int interval = targ->time_interval;
-    int value = 1;
+    int batch = targ->batch;
+    int bench = targ->bench;
+    unsigned long count = 0;
+    int log_items = g_log.level >= LOG_ITEMS;
+    uint64_t seq = 1;
 
     for (;;) {
         // Om Ctrl-C tryckts: trigga shutdown
         if (g_stop_flag) {
             pthread_mutex_lock(&rb->mtx);
             rb->shutdown = 1;
-            pthread_cond_broadcast(&rb->not_empty);
-            pthread_cond_broadcast(&rb->not_full);
+            rb_wake_all(rb);
             pthread_mutex_unlock(&rb->mtx);
             break;
         }
 
-        sleep_seconds(interval);
-
-        pthread_mutex_lock(&rb->mtx);
-        if (rb->shutdown) { pthread_mutex_unlock(&rb->mtx); break; }
-
-        while (rb->count == rb->size && !rb->shutdown) {
-            pthread_cond_wait(&rb->not_full, &rb->mtx);
+        int want = batch;
+        if (bench) {
+            if (targ->quota) {
+                if (count == targ->quota) break;
+                if ((unsigned long)want > targ->quota - count) want = (int)(targ->quota - count);
+            }
+        } else {
+            sleep_seconds(interval);
         }
-        if (rb->shutdown) { pthread_mutex_unlock(&rb->mtx); break; }
-
-        rb_enqueue(rb, value);
-        printf("[Producer] +%d (count=%d)\n", value, rb->count);
-        value++;
 
-        pthread_cond_signal(&rb->not_empty);
-        pthread_mutex_unlock(&rb->mtx);
+        // Skriv värdena direkt i bufferten; i mutex-läget hålls låset från
+        // reservationen till commit, så utskriften sker i samma kritiska sektion
+        rb_span_t sp;
+        if (rb_reserve(rb, want, &sp) < 0) break;
+        for (int i = 0; i < sp.n; ++i) {
+            sp.slots[i] = ITEM_MAKE(targ->id - 1, seq);
+            if (log_items) log_put(targ->log, LOG_PRODUCE, targ->id, seq, sp.count + i + 1);
+            seq++;
+        }
+        if (targ->latency) {
+            uint64_t stamp = now_ns();
+            for (int i = 0; i < sp.n; ++i) sp.stamps[i] = stamp;
+        }
+        rb_commit(rb, &sp);
+        count += sp.n;
     }
+    targ->count = count;
+
+    // Konsumenter i låsfritt läge väntar in sista producenten innan de ger upp
+    atomic_fetch_sub(&rb->producers_active, 1);
+    lf_wake(rb, &rb->wq_not_empty, INT_MAX);
 
-    printf("[Producer] Stänger.\n");
+    if (g_log.level >= LOG_EVENTS) log_put(targ->log, LOG_PRODUCER_EXIT, targ->id, 0, 0);
     return NULL;
 }
 
@@ -162,98 +1041,258 @@ static void *consumer_main(void *arg) {
     thread_arg_t *targ = (thread_arg_t*)arg;
     ring_buffer_t *rb = targ->rb;
     int id = targ->id;
+    int batch = targ->batch;
+    int bench = targ->bench;
+    int log_items = g_log.level >= LOG_ITEMS;
+    unsigned long count = 0;
+    item_t *vals = (item_t*)malloc(sizeof(item_t) * batch);
+    uint64_t *stamps = targ->latency ? (uint64_t*)malloc(sizeof(uint64_t) * batch) : NULL;
+    if (!vals || (targ->latency && !stamps)) { perror("malloc"); exit(EXIT_FAILURE); }
 
     for (;;) {
-        pthread_mutex_lock(&rb->mtx);
+        int n = 0, current = 0;
+        // Tömningsfristen har gått ut: hämta inget mer ur bufferten
+        if (atomic_load_explicit(&rb->drain_abort, memory_order_relaxed)) break;
+        if (rb->mode != RB_MUTEX) {
+            n = lf_get(rb, vals, stamps, batch, log_items ? &current : NULL);
+            if (n < 0) break;
+        } else {
+            pthread_mutex_lock(&rb->mtx);
 
-        while (rb->count == 0 && !rb->shutdown) {
-            // Om Ctrl-C har tryckts: markera shutdown och väck alla
-            if (g_stop_flag) {
-                rb->shutdown = 1;
-                pthread_cond_broadcast(&rb->not_empty);
-                pthread_cond_broadcast(&rb->not_full);
+            while (rb->count == 0 && !rb->shutdown) {
+                // Om Ctrl-C har tryckts: markera shutdown och väck alla
+                if (g_stop_flag) {
+                    rb->shutdown = 1;
+                    rb_wake_all(rb);
+                    break;
+                }
+                pthread_cond_wait(&rb->not_empty, &rb->mtx);
+            }
+
+            if (rb->shutdown && (rb->count == 0 || rb->drain_abort)) {
+                pthread_mutex_unlock(&rb->mtx);
                 break;
             }
-            pthread_cond_wait(&rb->not_empty, &rb->mtx);
-        }
 
-        if (rb->shutdown && rb->count == 0) {
+            n = rb_dequeue_batch(rb, vals, stamps, batch);
+            current = rb->count;
+            if (n > 1) pthread_cond_broadcast(&rb->not_full);
+            else       pthread_cond_signal(&rb->not_full);
             pthread_mutex_unlock(&rb->mtx);
-            break;
         }
 
-        int v = 0;
-        rb_dequeue(rb, &v);
-        int current = rb->count;
-        pthread_cond_signal(&rb->not_full);
-        pthread_mutex_unlock(&rb->mtx);
+        count += n;
+        if (targ->latency) {
+            uint64_t now = now_ns();
+            for (int i = 0; i < n; ++i) hist_record(targ->hist, now - stamps[i]);
+        }
+        if (bench) continue;
+        for (int i = 0; i < n; ++i) {
+            // Fristen kan gå ut mitt i en omgång. Resten av omgången är redan
+            // uttagen ur bufferten; den räknas som kasserad, inte konsumerad.
+            if (atomic_load_explicit(&rb->drain_abort, memory_order_relaxed)) {
+                unsigned long skipped = (unsigned long)(n - i);
+                count -= skipped;
+                atomic_fetch_sub(&rb->consumed_total, skipped);
+                atomic_fetch_add(&rb->discarded_total, skipped);
+                break;
+            }
+            if (log_items) log_put(targ->log, LOG_CONSUME, id, vals[i], current + (n - 1 - i));
+            sleep_millis(50); // simulera jobb
+        }
+    }
+    targ->count = count;
 
-        printf("  [Consumer %d] -%d (count=%d)\n", id, v, current);
-        sleep_millis(50); // simulera jobb
+    if (atomic_fetch_sub(&rb->consumers_active, 1) == 1) {
+        pthread_mutex_lock(&rb->mtx);
+        pthread_cond_broadcast(&rb->drained);
+        pthread_mutex_unlock(&rb->mtx);
     }
 
-    printf("  [Consumer %d] Stänger.\n", id);
+    free(stamps);
+    free(vals);
+    if (g_log.level >= LOG_EVENTS) log_put(targ->log, LOG_CONSUMER_EXIT, id, 0, 0);
     return NULL;
 }
 
 static void usage(const char *prog) {
-    fprintf(stderr, "Användning: %s N BufferSize TimeInterval\n", prog);
+    fprintf(stderr, "Användning: %s [-m mutex|spsc|mpmc] [-P Producers] [-b Batch] [-B PBatch]\n"
+                    "          [-d Sekunder | -i Antal] [-C] [-L] [-v 0|1|2] [-D Millis] [-S Spin]\n"
+                    "          N BufferSize TimeInterval\n", prog);
+    fprintf(stderr, "  -m          = buffertläge: mutex (standard, referens), spsc (låsfri, kräver N=1, P=1)\n");
+    fprintf(stderr, "                eller mpmc (låsfri, valfritt N och P)\n");
+    fprintf(stderr, "  -P          = antal producenttrådar (1..%d, standard 1)\n", MAX_PRODUCERS - 1);
+    fprintf(stderr, "  -b          = max antal värden en konsument hämtar per gång (>=1, standard 1)\n");
+    fprintf(stderr, "  -B          = max antal värden producenten reserverar och skriver per gång (>=1, standard 1)\n");
+    fprintf(stderr, "  -d          = benchmark: kör i angivet antal sekunder utan sömnar och utskrift per värde\n");
+    fprintf(stderr, "  -i          = benchmark: producera exakt så många värden totalt och töm sedan bufferten\n");
+    fprintf(stderr, "  -C          = benchmark: skriv resultatet som CSV (rubrikrad + en datarad)\n");
+    fprintf(stderr, "  -L          = mät kölatens per värde och skriv p50/p90/p99/p99.9/max\n");
+    fprintf(stderr, "  -v          = loggnivå: 0 bara summering, 1 även start/stopp, 2 även varje värde\n");
+    fprintf(stderr, "                (standard 2, i benchmarkläge 0)\n");
+    fprintf(stderr, "  -D          = tömningsfrist: efter stopp töms bufferten högst så många ms (standard obegränsat)\n");
+    fprintf(stderr, "  -S          = spsc/mpmc: max antal spinnvarv innan en väntande tråd parkerar\n");
+    fprintf(stderr, "                (självjusterande, standard %d, 0 på en processor; 0 = parkera direkt)\n", SPIN_DEFAULT);
     fprintf(stderr, "  N           = antal konsumenttrådar (>=1)\n");
     fprintf(stderr, "  BufferSize  = ringbuffer-storlek (>=1)\n");
     fprintf(stderr, "  TimeInterval= sekunder mellan producerade värden (>=0)\n");
 }
 
 int main(int argc, char **argv) {
-    if (argc != 4) { usage(argv[0]); return EXIT_FAILURE; }
+    rb_mode_t mode = RB_MUTEX;
+    int Batch = 1;
+    int PBatch = 1;
+    int P = 1;
+    double Duration = 0;
+    unsigned long Items = 0;
+    int csv = 0;
+    int latency = 0;
+    int verbosity = -1;
+    int DrainMs = -1;
+    int Spin = -1;
+    int argi = 1;
+    while (argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0') {
+        if (strcmp(argv[argi], "-m") == 0 && argi + 1 < argc) {
+            const char *m = argv[argi + 1];
+            if (strcmp(m, "mutex") == 0) mode = RB_MUTEX;
+            else if (strcmp(m, "spsc") == 0) mode = RB_SPSC;
+            else if (strcmp(m, "mpmc") == 0) mode = RB_MPMC;
+            else { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-P") == 0 && argi + 1 < argc) {
+            P = atoi(argv[argi + 1]);
+            if (P < 1 || P >= MAX_PRODUCERS) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-b") == 0 && argi + 1 < argc) {
+            Batch = atoi(argv[argi + 1]);
+            if (Batch < 1) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-B") == 0 && argi + 1 < argc) {
+            PBatch = atoi(argv[argi + 1]);
+            if (PBatch < 1) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-d") == 0 && argi + 1 < argc) {
+            Duration = atof(argv[argi + 1]);
+            if (Duration <= 0) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-i") == 0 && argi + 1 < argc) {
+            Items = strtoul(argv[argi + 1], NULL, 10);
+            if (Items == 0) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-C") == 0) {
+            csv = 1;
+            argi += 1;
+        } else if (strcmp(argv[argi], "-L") == 0) {
+            latency = 1;
+            argi += 1;
+        } else if (strcmp(argv[argi], "-v") == 0 && argi + 1 < argc) {
+            verbosity = atoi(argv[argi + 1]);
+            if (verbosity < LOG_QUIET || verbosity > LOG_ITEMS) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-D") == 0 && argi + 1 < argc) {
+            DrainMs = atoi(argv[argi + 1]);
+            if (DrainMs < 0) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else if (strcmp(argv[argi], "-S") == 0 && argi + 1 < argc) {
+            Spin = atoi(argv[argi + 1]);
+            if (Spin < 0) { usage(argv[0]); return EXIT_FAILURE; }
+            argi += 2;
+        } else { usage(argv[0]); return EXIT_FAILURE; }
+    }
+    int bench = Duration > 0 || Items > 0;
+    if (Spin < 0) Spin = online_cpus() > 1 ? SPIN_DEFAULT : 0;
+    if (verbosity < 0) verbosity = bench ? LOG_QUIET : LOG_ITEMS;
+    if ((Duration > 0 && Items > 0) || (csv && !bench)) { usage(argv[0]); return EXIT_FAILURE; }
+    if (argc - argi != 3) { usage(argv[0]); return EXIT_FAILURE; }
 
-    int N = atoi(argv[1]);
-    int BufferSize = atoi(argv[2]);
-    int TimeInterval = atoi(argv[3]);
+    int N = atoi(argv[argi]);
+    int BufferSize = atoi(argv[argi + 1]);
+    int TimeInterval = atoi(argv[argi + 2]);
     if (N < 1 || BufferSize < 1 || TimeInterval < 0) { usage(argv[0]); return EXIT_FAILURE; }
+    if (mode == RB_MPMC && BufferSize < 2) {
+        // Med en plats kan "ifylld" (seq == pos+1) inte skiljas från "ledig
+        // för nästa varv" (seq == pos+size)
+        fprintf(stderr, "mpmc-läget kräver BufferSize >= 2\n");
+        return EXIT_FAILURE;
+    }
+    if (mode == RB_SPSC && (N != 1 || P != 1)) {
+        fprintf(stderr, "spsc-läget kräver exakt en producent och en konsument (P=1, N=1)\n");
+        return EXIT_FAILURE;
+    }
 
-    // Installera signalhanterare (finns i både Windows/MinGW och Linux)
-    signal(SIGINT, handle_sigint);
+    // Signaler (och på Linux signalfd/eventfd) måste sättas upp innan första tråden startar
+    stop_events_init();
 
     ring_buffer_t rb;
-    rb_init(&rb, BufferSize);
+    rb_init(&rb, BufferSize, mode, Spin, latency);
 
-    // Starta “shutdown-watcher” som lyssnar på g_stop_flag
+    // Loggring 0 för watchern, sedan en per producent och en per konsument
+    int log_cons = 1 + P;
+    log_start(verbosity, P, 1 + P + N);
+
+    // Starta “shutdown-watcher” som väntar på stopp (signal eller internt)
     pthread_t shut_thr;
-    if (pthread_create(&shut_thr, NULL, shutdown_watcher, &rb) != 0) {
+    watcher_arg_t warg = { .rb = &rb, .drain_ms = DrainMs };
+    if (pthread_create(&shut_thr, NULL, shutdown_watcher, &warg) != 0) {
         perror("pthread_create shutdown_watcher");
+        log_stop();
         rb_destroy(&rb);
+        stop_events_close();
         return EXIT_FAILURE;
     }
 
-    // Starta producent
-    pthread_t prod;
-    thread_arg_t parg = { .id = 0, .rb = &rb, .time_interval = TimeInterval };
-    if (pthread_create(&prod, NULL, producer_main, &parg) != 0) {
-        perror("pthread_create producer");
-        pthread_mutex_lock(&rb.mtx);
-        rb.shutdown = 1;
-        pthread_cond_broadcast(&rb.not_empty);
-        pthread_cond_broadcast(&rb.not_full);
-        pthread_mutex_unlock(&rb.mtx);
+    // Starta producenter
+    double t_start = now_seconds();
+    pthread_t *prods = (pthread_t*)malloc(sizeof(pthread_t) * P);
+    thread_arg_t *pargs = (thread_arg_t*)calloc(P, sizeof(thread_arg_t));
+    if (!prods || !pargs) { perror("malloc"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < P; ++i) {
+        pargs[i].id = i + 1;
+        pargs[i].rb = &rb;
+        pargs[i].time_interval = TimeInterval;
+        pargs[i].batch = PBatch;
+        pargs[i].producers = P;
+        pargs[i].bench = bench;
+        pargs[i].quota = Items / P + ((unsigned long)i < Items % P ? 1 : 0);
+        pargs[i].latency = latency;
+        pargs[i].log = &g_log.rings[1 + i];
+        atomic_fetch_add(&rb.producers_active, 1);
+        if (pthread_create(&prods[i], NULL, producer_main, &pargs[i]) != 0) {
+            perror("pthread_create producer");
+            atomic_fetch_sub(&rb.producers_active, 1);
+            pthread_mutex_lock(&rb.mtx);
+            rb.shutdown = 1;
+            rb_wake_all(&rb);
+            pthread_mutex_unlock(&rb.mtx);
+            P = i; // antal som faktiskt startade
+            break;
+        }
+    }
+    if (P == 0) {
         pthread_join(shut_thr, NULL);
+        log_stop();
         rb_destroy(&rb);
+        stop_events_close();
+        free(prods); free(pargs);
         return EXIT_FAILURE;
     }
 
     // Starta konsumenter
     pthread_t *cons = (pthread_t*)malloc(sizeof(pthread_t) * N);
-    thread_arg_t *cargs = (thread_arg_t*)malloc(sizeof(thread_arg_t) * N);
+    thread_arg_t *cargs = (thread_arg_t*)calloc(N, sizeof(thread_arg_t));
     if (!cons || !cargs) {
         perror("malloc");
         pthread_mutex_lock(&rb.mtx);
         rb.shutdown = 1;
-        pthread_cond_broadcast(&rb.not_empty);
-        pthread_cond_broadcast(&rb.not_full);
+        rb_wake_all(&rb);
         pthread_mutex_unlock(&rb.mtx);
-        pthread_join(prod, NULL);
+        for (int i = 0; i < P; ++i) pthread_join(prods[i], NULL);
         pthread_join(shut_thr, NULL);
+        log_stop();
         rb_destroy(&rb);
+        stop_events_close();
         free(cons); free(cargs);
+        free(prods); free(pargs);
         return EXIT_FAILURE;
     }
 
@@ -261,31 +1300,116 @@ int main(int argc, char **argv) {
         cargs[i].id = i + 1;
         cargs[i].rb = &rb;
         cargs[i].time_interval = 0;
+        cargs[i].batch = Batch;
+        cargs[i].producers = P;
+        cargs[i].bench = bench;
+        cargs[i].latency = latency;
+        cargs[i].log = &g_log.rings[log_cons + i];
+        atomic_fetch_add(&rb.consumers_active, 1);
+        if (latency) {
+            cargs[i].hist = (hist_t*)calloc(1, sizeof(hist_t));
+            if (!cargs[i].hist) { perror("calloc"); exit(EXIT_FAILURE); }
+        }
         if (pthread_create(&cons[i], NULL, consumer_main, &cargs[i]) != 0) {
             perror("pthread_create consumer");
+            atomic_fetch_sub(&rb.consumers_active, 1);
             pthread_mutex_lock(&rb.mtx);
             rb.shutdown = 1;
-            pthread_cond_broadcast(&rb.not_empty);
-            pthread_cond_broadcast(&rb.not_full);
+            rb_wake_all(&rb);
             pthread_mutex_unlock(&rb.mtx);
             N = i; // antal som faktiskt startade
             break;
         }
     }
 
-    // Vänta in nedstängning
-    pthread_join(shut_thr, NULL);
-    pthread_join(prod, NULL);
+    // Benchmark: avsluta efter angiven tid eller när alla värden är producerade.
+    // Ett tidigare stopp (Ctrl-C) avbryter väntan; producenterna ser då shutdown.
+    int prods_joined = 0;
+    if (bench) {
+        if (Duration > 0) {
+            rb_wait_shutdown(&rb, (long)(Duration * 1000));
+        } else {
+            for (int i = 0; i < P; ++i) pthread_join(prods[i], NULL);
+            prods_joined = 1;
+        }
+        rb_shutdown(&rb);
+        if (!g_stop_flag) request_stop();
+    }
+
+    // Vänta in nedstängning; tiden mäts till att sista konsumenten är klar
     for (int i = 0; i < N; ++i) pthread_join(cons[i], NULL);
+    double elapsed = now_seconds() - t_start;
+    pthread_join(shut_thr, NULL);
+    if (!prods_joined)
+        for (int i = 0; i < P; ++i) pthread_join(prods[i], NULL);
+    log_stop();
+
+    // Slå ihop trådarnas latenshistogram
+    hist_t lat;
+    memset(&lat, 0, sizeof(lat));
+    for (int i = 0; i < N; ++i) if (cargs[i].hist) hist_merge(&lat, cargs[i].hist);
+    static const double lat_q[] = { 0.50, 0.90, 0.99, 0.999 };
+
+    if (bench) {
+        static const char *mode_names[] = { "mutex", "spsc", "mpmc" };
+        unsigned long consumed = atomic_load(&rb.consumed_total);
+        double ips = elapsed > 0 ? consumed / elapsed : 0;
+        double nspi = consumed > 0 ? elapsed * 1e9 / consumed : 0;
+        if (csv) {
+            printf("mode,producers,consumers,buffer,batch,pbatch,items,seconds,items_per_sec,ns_per_item,"
+                   "producer_counts,consumer_counts,lat_p50_ns,lat_p90_ns,lat_p99_ns,lat_p999_ns,lat_max_ns\n");
+            printf("%s,%d,%d,%d,%d,%d,%lu,%.6f,%.0f,%.2f,", mode_names[mode], P, N, BufferSize,
+                   Batch, PBatch, consumed, elapsed, ips, nspi);
+            for (int i = 0; i < P; ++i) printf("%s%lu", i ? ";" : "", pargs[i].count);
+            printf(",");
+            for (int i = 0; i < N; ++i) printf("%s%lu", i ? ";" : "", cargs[i].count);
+            if (latency) {
+                for (int q = 0; q < 4; ++q) printf(",%llu", (unsigned long long)hist_percentile(&lat, lat_q[q]));
+                printf(",%llu\n", (unsigned long long)lat.max);
+            } else {
+                printf(",,,,,\n");
+            }
+            for (int i = 0; i < N; ++i) free(cargs[i].hist);
+            rb_destroy(&rb);
+            stop_events_close();
+            free(cons); free(cargs);
+            free(prods); free(pargs);
+            return EXIT_SUCCESS;
+        }
+        printf("\n=== Benchmark ===\n");
+        printf("Läge: %s, P=%d, N=%d, BufferSize=%d, b=%d, B=%d\n",
+               mode_names[mode], P, N, BufferSize, Batch, PBatch);
+        printf("Tid: %.3f s\n", elapsed);
+        printf("Genomströmning: %.0f värden/s (%.2f ns/värde)\n", ips, nspi);
+        if (mode != RB_MUTEX)
+            printf("Parkeringar: %lu konsument, %lu producent (spinnbudget nu %d/%d)\n",
+                   atomic_load(&rb.wq_not_empty.parks), atomic_load(&rb.wq_not_full.parks),
+                   atomic_load(&rb.wq_not_empty.spin), atomic_load(&rb.wq_not_full.spin));
+        for (int i = 0; i < N; ++i) printf("  Konsument %d: %lu\n", cargs[i].id, cargs[i].count);
+    }
 
     // Summering
     printf("\n=== Summering ===\n");
-    printf("Producerat: %lu\n", rb.produced_total);
-    printf("Konsumerat: %lu\n", rb.consumed_total);
-    printf("Kvar i buffert: %d\n", rb.count);
+    printf("Producerat: %lu\n", atomic_load(&rb.produced_total));
+    if (P > 1 || bench)
+        for (int i = 0; i < P; ++i) printf("  Producent %d: %lu\n", pargs[i].id, pargs[i].count);
+    printf("Konsumerat: %lu\n", atomic_load(&rb.consumed_total));
+    printf("Kvar i buffert: %d\n", rb_count(&rb));
+    if (atomic_load(&rb.discarded_total) > 0)
+        printf("Kasserat vid tömningsfristen: %lu\n", atomic_load(&rb.discarded_total));
+    if (latency) {
+        printf("Kölatens (ns, %lu värden): p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu\n", lat.total,
+               (unsigned long long)hist_percentile(&lat, 0.50), (unsigned long long)hist_percentile(&lat, 0.90),
+               (unsigned long long)hist_percentile(&lat, 0.99), (unsigned long long)hist_percentile(&lat, 0.999),
+               (unsigned long long)lat.max);
+    }
+    for (int i = 0; i < N; ++i) free(cargs[i].hist);
 
     rb_destroy(&rb);
+    stop_events_close();
     free(cons);
     free(cargs);
+    free(prods);
+    free(pargs);
     return EXIT_SUCCESS;
 }
@@ -1,20 +1,64 @@
 // DVGB19 Lab 2 — Virtual Memory Simulator (vmsim)
 // Karlstad University — Implements FIFO, LRU, Optimal with pure demand paging
+// (plus CLOCK-family, adaptive, scan-resistant, frequency-based and
+// working-set policies for comparison)
 // Author: ChatGPT (assistant)
-// Build (Linux/macOS/WSL):   gcc -O2 -std=c11 -Wall -Wextra -o vmsim vmsim.c
-// Build (Windows/MinGW):     gcc -O2 -std=c11 -Wall -Wextra -o vmsim.exe vmsim.c
+// Build (Linux/macOS/WSL):   gcc -O2 -std=c11 -Wall -Wextra -pthread -o vmsim vmsim.c
+// Build (Windows/MinGW):     gcc -O2 -std=c11 -Wall -Wextra -pthread -o vmsim.exe vmsim.c
 // Usage:
-//   vmsim -a <fifo|lru|optimal> -n <frames> -f <trace file>
+//   vmsim -a <algorithm> -n <frames> -f <trace file|-> [-S] [-t]
+//         [-o summary|faults|full] [-q <kin%>,<kout%>] [-l <hir%>] [-g <avg>]
+//         [-T <tau>]
+//   vmsim -f <trace file|-> -c <binary out> [-e raw|delta]
+//   vmsim -M <lru|optimal> -f <trace file|-> [-n <max frames>]
+//   vmsim -w <alg,alg,...|all> -n <frame list> -f <trace file|-> [-j <threads>]
+//   (-t reports trace parse throughput on stderr; -c converts a text trace
+//    to the binary format below, which -f then accepts as well; -f - reads
+//    stdin; -S streams the trace in chunks instead of preloading it, for
+//    the policies that never look ahead; -o limits the per-access log to
+//    faults or drops it, default full; -M prints the fault count for every
+//    frame count 1..max from a single pass, see miss-ratio curves below;
+//    -w sweeps every algorithm x frame count pair, e.g. -n 1-64,128,200-256:8,
+//    on a thread pool and prints one CSV row per pair)
+//   algorithms: fifo, lru, lru-scan, optimal, clock, second-chance, gclock,
+//               arc, car, lirs, 2q, lfu, lfu-aging, ws, wsclock
+//   (lru keeps frames on an O(1) recency list; lru-scan is the original
+//    O(frames) timestamp scan, kept to cross-check the output)
+//   (clock sweeps a hand over per-frame reference bits; second-chance is the
+//    same policy as a FIFO queue that re-queues referenced pages; gclock keeps
+//    a saturating use counter per frame that the hand decrements)
+//   (arc and car split memory between recently and frequently used pages and
+//    adapt the split on hits in ghost lists of recently evicted pages; arc
+//    keeps both parts as LRU lists, car as clocks)
+//   (lirs ranks pages by reuse distance: LIR pages stay resident, and only a
+//    small HIR part (-l, default 1% of frames) takes new and cold pages;
+//    2q admits new pages to a FIFO A1in (-q kin, default 25% of frames) and
+//    only pages re-referenced while remembered in the ghost FIFO A1out
+//    (-q kout, default 50%) reach the LRU main queue Am)
+//   (lfu evicts the least frequently used page, oldest first among equals;
+//    lfu-aging halves all counts whenever their average exceeds -g, default
+//    10, so pages that were hot long ago eventually become evictable)
+//   (ws is the working-set model: memory holds exactly the pages used in the
+//    last tau accesses (-T, default 1000), and frames are freed as pages
+//    leave that window; -n only caps it, beyond that the LRU page goes.
+//    wsclock sweeps a clock hand over reference bits and per-frame last-use
+//    stamps in virtual time and evicts the first page older than tau. Both
+//    log a working-set size line every tau accesses and summarize its
+//    distribution.)
 //
 // Spec highlights:
 //  • Virtual address space: 16-bit (0x0000–0xFFFF)
 //  • Page/frame size: 256 bytes (thus 256 virtual pages total)
 //  • Physical memory size: <frames> × 256 bytes; frames > 0
-//  • Input trace: one hex address per line, e.g., 0x01FF
+//  • Input trace: one hex address per line, e.g., 0x01FF (or binary, see -c)
 //  • For each access: print address, hit/fault, and any replacement (page out/in)
 //  • Summary at the end: frames, total accesses, hits, faults, replacements
 //
-// The simulator preloads the entire trace to support OPT (Belady) efficiently.
+// The simulator preloads the entire trace to support OPT (Belady) efficiently;
+// with -S the other policies run in constant memory while the trace is read.
+// The trace file is memory-mapped (read whole on Windows) and decoded in place.
+
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,60 +66,510 @@
 #include <stdint.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define PAGE_SIZE 256               // bytes per page/frame
 #define VIRTUAL_PAGES 256           // 64 KiB / 256 B
 #define INF_NEXT 0x7fffffff
+#define GCLOCK_INIT 1               // GCLOCK: counter of a newly loaded page
+#define GCLOCK_MAX 8                // GCLOCK: counter saturates here
+#define WS_BINS 16                  // ws, wsclock: rows of the working-set size histogram
 
 // Replacement algorithms
-typedef enum { ALG_FIFO, ALG_LRU, ALG_OPTIMAL } alg_t;
+typedef enum { ALG_FIFO, ALG_LRU, ALG_LRU_SCAN, ALG_OPTIMAL, ALG_CLOCK, ALG_SECOND_CHANCE, ALG_GCLOCK,
+               ALG_ARC, ALG_CAR, ALG_LIRS, ALG_2Q,
+               ALG_LFU, ALG_LFU_AGING, ALG_WS, ALG_WSCLOCK } alg_t;
+
+// Command-line names, indexed by alg_t
+static const char *const alg_keys[] = { "fifo", "lru", "lru-scan", "optimal", "clock", "second-chance", "gclock", "arc", "car", "lirs", "2q", "lfu", "lfu-aging", "ws", "wsclock" };
+#define NUM_ALGS ((int)(sizeof(alg_keys)/sizeof(alg_keys[0])))
+
+static bool parse_alg(const char *name, alg_t *out){
+    for(int a=0; a<NUM_ALGS; ++a) if(strcmp(name, alg_keys[a])==0){ *out = (alg_t)a; return true; }
+    return false;
+}
 
 static const char* alg_name(alg_t a){
     switch(a){
         case ALG_FIFO: return "FIFO";
-        case ALG_LRU: return "LRU";
+        case ALG_LRU:
+        case ALG_LRU_SCAN: return "LRU";
         case ALG_OPTIMAL: return "Optimal";
+        case ALG_CLOCK: return "CLOCK";
+        case ALG_SECOND_CHANCE: return "Second chance";
+        case ALG_GCLOCK: return "GCLOCK";
+        case ALG_ARC: return "ARC";
+        case ALG_CAR: return "CAR";
+        case ALG_LIRS: return "LIRS";
+        case ALG_2Q: return "2Q";
+        case ALG_LFU: return "LFU";
+        case ALG_LFU_AGING: return "LFU (aging)";
+        case ALG_WS: return "Working set";
+        case ALG_WSCLOCK: return "WSClock";
         default: return "?";
     }
 }
 
-// Dynamic vector for trace of page numbers
+// Dynamic vector of trace addresses (page = addr >> 8)
 typedef struct {
-    int *data;        // page numbers (0..255)
+    uint16_t *data;
     int  size;
     int  cap;
-} ivec_t;
+} avec_t;
 
-static void ivec_init(ivec_t *v){ v->data=NULL; v->size=0; v->cap=0; }
-static void ivec_push(ivec_t *v, int x){
-    if(v->size==v->cap){ v->cap = v->cap? v->cap*2 : 1024; v->data = (int*)realloc(v->data, v->cap*sizeof(int)); if(!v->data){ perror("realloc"); exit(1);} }
+static void avec_init(avec_t *v){ v->data=NULL; v->size=0; v->cap=0; }
+static void avec_reserve(avec_t *v, int cap){
+    if(cap <= v->cap) return;
+    v->cap = cap; v->data = (uint16_t*)realloc(v->data, (size_t)v->cap*sizeof(uint16_t)); if(!v->data){ perror("realloc"); exit(1);}
+}
+// Callers keep size below INT32_MAX; growth doubles but stops at INT32_MAX
+static void avec_push(avec_t *v, uint16_t x){
+    if(v->size==v->cap) avec_reserve(v, !v->cap ? 1024 : v->cap > INT32_MAX/2 ? INT32_MAX : v->cap*2);
     v->data[v->size++] = x;
 }
-static void ivec_free(ivec_t *v){ free(v->data); v->data=NULL; v->size=v->cap=0; }
-
-// For OPT: store future positions for each page in a vector and a pointer index
-typedef struct { ivec_t pos; int ptr; } future_list_t;
-
-// Simple line reader (robust to CRLF, blanks, comments)
-static bool read_hex_address(FILE *fp, uint16_t *out){
-    char buf[128];
-    while(fgets(buf, sizeof(buf), fp)){
-        // Trim leading spaces
-        char *p = buf; while(isspace((unsigned char)*p)) p++;
-        if(*p=='\0' || *p=='#' || *p=='\n') continue; // skip blanks/comments
-        // Accept forms: 0xABCD, ABCD, 0xabcd
-        unsigned int val;
-        if(strncmp(p, "0x", 2)==0 || strncmp(p, "0X", 2)==0){
-            if(sscanf(p, "%x", &val)!=1) continue;
-        } else {
-            if(sscanf(p, "%x", &val)!=1) continue;
+static void avec_free(avec_t *v){ free(v->data); v->data=NULL; v->size=v->cap=0; }
+
+// Whole trace in memory: either owned storage or a view into the mapped file
+typedef struct {
+    const uint16_t *addr;
+    int size;
+    avec_t own;
+} trace_t;
+
+static void trace_free(trace_t *t){ avec_free(&t->own); t->addr=NULL; t->size=0; }
+
+// Intrusive doubly linked list over indices 0..n-1 (frames); -1 terminates.
+// head = most recently inserted/moved, tail = oldest.
+typedef struct {
+    int *prev, *next;
+    int head, tail;
+    int size;
+} dlist_t;
+
+static void dlist_init(dlist_t *l, int n){
+    l->prev = (int*)malloc(sizeof(int)*n); l->next = (int*)malloc(sizeof(int)*n);
+    if(!l->prev || !l->next){ perror("malloc"); exit(1); }
+    for(int i=0;i<n;++i){ l->prev[i] = l->next[i] = -1; }
+    l->head = l->tail = -1;
+    l->size = 0;
+}
+static int imax(int a, int b){ return a > b ? a : b; }
+static int imin(int a, int b){ return a < b ? a : b; }
+
+static void dlist_free(dlist_t *l){ free(l->prev); free(l->next); l->prev=l->next=NULL; }
+static void dlist_unlink(dlist_t *l, int i){
+    if(l->prev[i]!=-1) l->next[l->prev[i]] = l->next[i]; else l->head = l->next[i];
+    if(l->next[i]!=-1) l->prev[l->next[i]] = l->prev[i]; else l->tail = l->prev[i];
+    l->prev[i] = l->next[i] = -1;
+    l->size--;
+}
+static void dlist_push_front(dlist_t *l, int i){
+    l->prev[i] = -1; l->next[i] = l->head;
+    if(l->head!=-1) l->prev[l->head] = i; else l->tail = i;
+    l->head = i;
+    l->size++;
+}
+static bool dlist_contains(const dlist_t *l, int i){ return l->prev[i]!=-1 || l->head==i; }
+static void dlist_move_front(dlist_t *l, int i){
+    if(l->head==i) return;
+    dlist_unlink(l, i); dlist_push_front(l, i);
+}
+
+// For OPT: next_use[i] = index of the next access to the same page as access i
+// (INF_NEXT if never used again), built in one backward pass over the trace
+static int *build_next_use(const trace_t *t){
+    int *next_use = (int*)malloc(sizeof(int)*(size_t)(t->size ? t->size : 1));
+    if(!next_use){ perror("malloc"); exit(1); }
+    int last[VIRTUAL_PAGES];
+    for(int p=0;p<VIRTUAL_PAGES;++p) last[p] = INF_NEXT;
+    for(int i=t->size-1;i>=0;--i){ int p = t->addr[i] >> 8; next_use[i] = last[p]; last[p] = i; }
+    return next_use;
+}
+
+// Trace file contents, mapped read-only where possible
+typedef struct {
+    const char *data;
+    size_t size;
+    bool mapped;
+} file_map_t;
+
+static FILE *open_input(const char *path){
+    if(strcmp(path, "-")!=0) return fopen(path, "rb");
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    return stdin;
+}
+static void close_input(FILE *fp){ if(fp != stdin) fclose(fp); }
+
+static bool map_file(const char *path, file_map_t *m){
+    m->data = NULL; m->size = 0; m->mapped = false;
+#ifndef _WIN32
+    int fd = strcmp(path, "-")==0 ? -1 : open(path, O_RDONLY);
+    struct stat st;
+    if(fd >= 0 && fstat(fd, &st)==0 && S_ISREG(st.st_mode)){
+        if(st.st_size == 0){ close(fd); return true; }
+        void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(base != MAP_FAILED){
+            posix_madvise(base, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            m->data = (const char*)base; m->size = (size_t)st.st_size; m->mapped = true;
+            close(fd);
+            return true;
+        }
+    }
+    if(fd >= 0) close(fd);
+#endif
+    // Fallback: read the whole file (or stdin) into memory
+    FILE *fp = open_input(path);
+    if(!fp) return false;
+    size_t cap = 1<<16, n = 0; char *buf = (char*)malloc(cap);
+    if(!buf){ perror("malloc"); exit(1); }
+    size_t got;
+    while((got = fread(buf+n, 1, cap-n, fp)) > 0){
+        n += got;
+        if(n==cap){ cap *= 2; buf = (char*)realloc(buf, cap); if(!buf){ perror("realloc"); exit(1); } }
+    }
+    close_input(fp);
+    m->data = buf; m->size = n;
+    return true;
+}
+
+static void unmap_file(file_map_t *m){
+    if(!m->data) return;
+#ifndef _WIN32
+    if(m->mapped) munmap((void*)m->data, m->size); else
+#endif
+    free((void*)m->data);
+    m->data = NULL; m->size = 0; m->mapped = false;
+}
+
+// Hex digit value per byte, 0xFF for anything that is not a hex digit
+static unsigned char hexval[256];
+static void hexval_init(void){
+    memset(hexval, 0xFF, sizeof(hexval));
+    for(int c='0'; c<='9'; ++c) hexval[c] = (unsigned char)(c-'0');
+    for(int c='a'; c<='f'; ++c){ hexval[c] = (unsigned char)(c-'a'+10); hexval[c-'a'+'A'] = (unsigned char)(c-'a'+10); }
+}
+
+// General field decoder, same rules as sscanf("%x"): optional sign, optional
+// 0x/0X, hex digits up to the first non-digit; fails if there are no digits
+static bool decode_hex_field(const char *p, const char *end, uint16_t *out){
+    bool neg = false, any = false, sat = false;
+    uint64_t v = 0;
+    if(p<end && (*p=='+' || *p=='-')){ neg = *p=='-'; p++; }
+    if(p+1<end && p[0]=='0' && (p[1]|0x20)=='x'){ p += 2; any = true; }
+    for(; p<end && hexval[(unsigned char)*p] < 16; ++p){
+        if(v >> 60) sat = true;
+        v = (v << 4) | hexval[(unsigned char)*p]; any = true;
+    }
+    if(!any) return false;
+    if(sat) v = UINT64_MAX;
+    else if(neg) v = (uint64_t)0 - v;
+    *out = (uint16_t)((unsigned int)v & 0xFFFF);
+    return true;
+}
+
+// Next address in [*pp, end), skipping blanks/comments (robust to CRLF);
+// *pp is left at the start of the following line
+static bool next_hex_address(const char **pp, const char *end, uint16_t *out){
+    const char *p = *pp;
+    while(p < end){
+        // Trim leading whitespace (also swallows empty lines)
+        while(p<end && isspace((unsigned char)*p)) p++;
+        if(p==end) break;
+        const char *line = p;
+        // Fast path: the common fixed-width "0xABCD" line
+        if(end-p >= 7 && p[0]=='0' && (p[1]|0x20)=='x'){
+            unsigned a = hexval[(unsigned char)p[2]], b = hexval[(unsigned char)p[3]];
+            unsigned c = hexval[(unsigned char)p[4]], d = hexval[(unsigned char)p[5]];
+            if((a|b|c|d) < 16 && hexval[(unsigned char)p[6]] > 15){
+                *out = (uint16_t)(a<<12 | b<<8 | c<<4 | d);
+                if(p[6]=='\n') p += 7;
+                else { const char *nl = memchr(p+6, '\n', (size_t)(end-p-6)); p = nl? nl+1 : end; }
+                *pp = p;
+                return true;
+            }
         }
-        *out = (uint16_t)(val & 0xFFFF);
-        return true;
+        const char *nl = memchr(p, '\n', (size_t)(end-p));
+        p = nl? nl+1 : end;
+        if(*line=='#') continue; // skip comments
+        if(decode_hex_field(line, nl? nl : end, out)){ *pp = p; return true; }
     }
+    *pp = end;
     return false;
 }
 
+static bool load_text_trace(const file_map_t *m, trace_t *t){
+    hexval_init();
+    avec_init(&t->own);
+    size_t guess = m->size/7;   // "0xABCD\n"
+    avec_reserve(&t->own, guess < 1024 ? 1024 : guess > INT32_MAX/2 ? INT32_MAX/2 : (int)guess);
+    const char *cur = m->data, *end = m->data + m->size;
+    uint16_t addr;
+    while(next_hex_address(&cur, end, &addr)){
+        if(t->own.size == INT32_MAX){ fprintf(stderr, "Trace too long.\n"); return false; }
+        avec_push(&t->own, addr);
+    }
+    t->addr = t->own.data; t->size = t->own.size;
+    return true;
+}
+
+// Binary trace format (little-endian):
+//   "VMTR" | u8 version=1 | u8 address bits=16 | u8 encoding | u8 0 | u64 count
+// followed by count addresses, either raw u16 (TRACE_RAW) or LEB128 varints
+// of the zigzag-coded 16-bit difference to the previous address (TRACE_DELTA)
+#define TRACE_MAGIC "VMTR"
+#define TRACE_HDR 16
+enum { TRACE_RAW = 0, TRACE_DELTA = 1 };
+
+static bool host_little_endian(void){ uint16_t x = 1; unsigned char c; memcpy(&c, &x, 1); return c==1; }
+
+static bool is_binary_trace(const file_map_t *m){
+    return m->size >= TRACE_HDR && memcmp(m->data, TRACE_MAGIC, 4)==0;
+}
+
+static bool load_binary_trace(const file_map_t *m, trace_t *t){
+    const unsigned char *h = (const unsigned char*)m->data;
+    avec_init(&t->own); t->addr = NULL; t->size = 0;
+    if(h[4]!=1 || h[5]!=16 || h[6]>TRACE_DELTA){ fprintf(stderr, "Unsupported binary trace (version %d, %d-bit, encoding %d).\n", h[4], h[5], h[6]); return false; }
+    uint64_t count = 0;
+    for(int b=7;b>=0;--b) count = count<<8 | h[8+b];
+    if(count > INT32_MAX){ fprintf(stderr, "Trace too long.\n"); return false; }
+    const unsigned char *p = h + TRACE_HDR, *end = h + m->size;
+    if(h[6]==TRACE_RAW){
+        if((uint64_t)(end-p) < count*2){ fprintf(stderr, "Truncated binary trace.\n"); return false; }
+        if(host_little_endian()){ t->addr = (const uint16_t*)p; t->size = (int)count; return true; } // zero-copy
+        avec_reserve(&t->own, (int)count);
+        for(uint64_t i=0;i<count;++i) t->own.data[i] = (uint16_t)(p[2*i] | p[2*i+1]<<8);
+    } else {
+        avec_reserve(&t->own, (int)count);
+        unsigned prev = 0;
+        for(uint64_t i=0;i<count;++i){
+            unsigned zz = 0; int shift = 0;
+            for(;;){
+                if(p==end || shift>14){ fprintf(stderr, "Truncated or corrupt binary trace.\n"); return false; }
+                unsigned char c = *p++;
+                zz |= (unsigned)(c & 0x7F) << shift; shift += 7;
+                if(!(c & 0x80)) break;
+            }
+            int d = (zz & 1) ? -(int)((zz+1) >> 1) : (int)(zz >> 1);
+            prev = (prev + (unsigned)d) & 0xFFFF;
+            t->own.data[i] = (uint16_t)prev;
+        }
+    }
+    t->own.size = (int)count;
+    t->addr = t->own.data; t->size = t->own.size;
+    return true;
+}
+
+static bool write_binary_trace(const char *path, const trace_t *t, int enc){
+    FILE *fp = fopen(path, "wb");
+    if(!fp){ perror("fopen output"); return false; }
+    unsigned char hdr[TRACE_HDR] = { 'V','M','T','R', 1, 16, (unsigned char)enc, 0 };
+    for(int b=0;b<8;++b) hdr[8+b] = (unsigned char)((uint64_t)t->size >> (8*b));
+    bool ok = fwrite(hdr, 1, TRACE_HDR, fp)==TRACE_HDR;
+    if(enc==TRACE_RAW && host_little_endian()){
+        ok = ok && fwrite(t->addr, sizeof(uint16_t), (size_t)t->size, fp)==(size_t)t->size;
+    } else {
+        static unsigned char buf[1<<16]; size_t n = 0; unsigned prev = 0;
+        for(int i=0; ok && i<t->size; ++i){
+            unsigned a = t->addr[i];
+            if(enc==TRACE_RAW){ buf[n++] = (unsigned char)a; buf[n++] = (unsigned char)(a>>8); }
+            else {
+                int d = (int)((a - prev) & 0xFFFF); if(d >= 0x8000) d -= 0x10000;
+                unsigned zz = d < 0 ? (unsigned)(-d)*2 - 1 : (unsigned)d*2;
+                while(zz >= 0x80){ buf[n++] = (unsigned char)(zz | 0x80); zz >>= 7; }
+                buf[n++] = (unsigned char)zz;
+                prev = a;
+            }
+            if(n > sizeof(buf)-4){ ok = fwrite(buf, 1, n, fp)==n; n = 0; }
+        }
+        ok = ok && fwrite(buf, 1, n, fp)==n;
+    }
+    if(fclose(fp)!=0) ok = false;
+    if(!ok) perror("write output");
+    return ok;
+}
+
+// Streaming reader: decodes a text or binary trace chunk by chunk from a
+// fixed-size buffer, so memory use does not depend on the trace length
+#define STREAM_BUF (1<<20)
+
+typedef struct {
+    FILE *fp;
+    char *buf;
+    size_t pos, len;        // undecoded bytes are buf[pos..len)
+    bool eof;
+    int format;             // -1 text, else TRACE_RAW / TRACE_DELTA
+    uint64_t left;          // binary: addresses still to decode
+    unsigned prev;          // delta: previous address
+    uint64_t bytes;         // total bytes read
+} trace_stream_t;
+
+static void stream_fill(trace_stream_t *st){
+    if(st->eof) return;
+    memmove(st->buf, st->buf + st->pos, st->len - st->pos);
+    st->len -= st->pos; st->pos = 0;
+    size_t got = fread(st->buf + st->len, 1, STREAM_BUF - st->len, st->fp);
+    st->len += got; st->bytes += got;
+    if(got == 0){
+        if(ferror(st->fp)) perror("read trace");
+        st->eof = true;
+    }
+}
+
+static bool stream_open(trace_stream_t *st, const char *path){
+    memset(st, 0, sizeof(*st));
+    st->fp = open_input(path);
+    if(!st->fp) return false;
+    st->buf = (char*)malloc(STREAM_BUF);
+    if(!st->buf){ perror("malloc"); exit(1); }
+    while(!st->eof && st->len < TRACE_HDR) stream_fill(st);
+    st->format = -1;
+    file_map_t head = { st->buf, st->len, false };
+    if(is_binary_trace(&head)){
+        const unsigned char *h = (const unsigned char*)st->buf;
+        if(h[4]!=1 || h[5]!=16 || h[6]>TRACE_DELTA){ fprintf(stderr, "Unsupported binary trace (version %d, %d-bit, encoding %d).\n", h[4], h[5], h[6]); return false; }
+        st->format = h[6];
+        for(int b=7;b>=0;--b) st->left = st->left<<8 | h[8+b];
+        st->pos = TRACE_HDR;
+    } else hexval_init();
+    return true;
+}
+
+static void stream_close(trace_stream_t *st){
+    if(st->fp) close_input(st->fp);
+    free(st->buf); st->buf = NULL; st->fp = NULL;
+}
+
+// Decodes up to max addresses into out; returns how many, 0 at the end, -1 on error
+static int stream_next(trace_stream_t *st, uint16_t *out, int max){
+    int n = 0;
+    if(st->format < 0){
+        for(;;){
+            // Only hand complete lines to the parser, unless the input has ended
+            const char *start = st->buf + st->pos, *limit = st->buf + st->len;
+            if(!st->eof){
+                while(limit > start && limit[-1] != '\n') limit--;
+                if(limit == start){
+                    if(st->pos == 0 && st->len == STREAM_BUF){ fprintf(stderr, "Trace line too long.\n"); return -1; }
+                    stream_fill(st); continue;
+                }
+            }
+            const char *cur = start;
+            while(n < max && next_hex_address(&cur, limit, &out[n])) n++;
+            st->pos = (size_t)(cur - st->buf);
+            if(n > 0 || st->eof) return n;
+            stream_fill(st);
+        }
+    }
+    if(st->len - st->pos < 16) stream_fill(st);
+    const unsigned char *p = (const unsigned char*)st->buf + st->pos, *end = (const unsigned char*)st->buf + st->len;
+    if(st->format == TRACE_RAW){
+        while(n < max && st->left > 0 && end - p >= 2){ out[n++] = (uint16_t)(p[0] | p[1]<<8); p += 2; st->left--; }
+    } else {
+        while(n < max && st->left > 0){
+            unsigned zz = 0; int shift = 0; const unsigned char *q = p;
+            for(;;){
+                if(q==end || shift>14) break;
+                unsigned char c = *q++;
+                zz |= (unsigned)(c & 0x7F) << shift; shift += 7;
+                if(!(c & 0x80)){ shift = -1; break; }
+            }
+            if(shift != -1){
+                if(q==end && !st->eof) break;  // record continues in the next chunk
+                fprintf(stderr, "Truncated or corrupt binary trace.\n"); return -1;
+            }
+            int d = (zz & 1) ? -(int)((zz+1) >> 1) : (int)(zz >> 1);
+            st->prev = (st->prev + (unsigned)d) & 0xFFFF;
+            out[n++] = (uint16_t)st->prev; st->left--; p = q;
+        }
+    }
+    st->pos = (size_t)((const char*)p - st->buf);
+    if(n == 0 && st->left > 0){
+        if(st->eof){ fprintf(stderr, "Truncated binary trace.\n"); return -1; }
+        stream_fill(st);
+        return stream_next(st, out, max);
+    }
+    return n;
+}
+
+static double now_seconds(void){
+    struct timespec ts; timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ARC/CAR state. All four lists hold page numbers: T1/T2 are resident
+// (seen once recently / seen at least twice), B1/B2 are their ghosts, i.e.
+// pages recently evicted from T1/T2. p is the adaptive target size of T1.
+// 2Q reuses the lists: T1 = A1in, T2 = Am, B1 = A1out.
+enum { ARC_NONE, ARC_T1, ARC_T2, ARC_B1, ARC_B2 };
+typedef struct {
+    dlist_t t1, t2, b1, b2;            // front = MRU (arc) / newest, behind the hand (car)
+    unsigned char where[VIRTUAL_PAGES];
+    unsigned char ref[VIRTUAL_PAGES];  // car: reference bit per page
+    int p;
+    long b1_hits, b2_hits;             // misses found in a ghost list
+    int kin, kout;                     // 2q: A1in / A1out capacity in pages
+    long a1in_hits, am_hits;           // 2q
+} arc_t;
+
+// LIRS state. S is the LIRS stack (front = top) holding LIR pages and
+// recently seen HIR pages, resident or not; its bottom is always LIR. Q
+// holds the resident HIR pages (front = newest). A page can be in both.
+enum { LIRS_NONE, LIRS_LIR, LIRS_HIR, LIRS_NHIR };  // NHIR = non-resident HIR, in S only
+typedef struct {
+    dlist_t s, q;
+    unsigned char state[VIRTUAL_PAGES];
+    int lir_count, lir_max;
+    long lir_hits, hir_hits;           // hits on LIR / resident HIR pages
+    long promotions;                   // HIR -> LIR (hit in S, or refault while in S)
+} lirs_t;
+
+// LFU state: frames grouped into buckets of equal use count. Buckets form a
+// list in increasing count order; inside a bucket frames are kept newest
+// first, so the victim is the tail of the first bucket. A hit moves the
+// frame to the bucket for count+1, created right after its own if missing.
+typedef struct {
+    int *bucket;                       // per frame: its bucket (or -1)
+    int *iprev, *inext;                // per frame: neighbours within the bucket
+    long *bcount;                      // per bucket: use count of its frames
+    int *bhead, *btail, *bsize;        // per bucket: frames, front = newest
+    int *bprev, *bnext;                // bucket list, ascending count
+    int first;                         // bucket with the lowest count (or -1)
+    int *bfree; int nfree;             // unused bucket ids
+    long sum;                          // sum of counts over resident frames
+    int resident;
+    long evictions, evicted_sum;       // for the average count at eviction
+    long agings;
+} lfu_t;
+
+// Working-set window (ws, wsclock): the pages used in the last tau accesses,
+// on a recency list so that they leave from the tail as they age out
+typedef struct {
+    dlist_t pages;                     // front = most recently used
+    long last[VIRTUAL_PAGES];          // per page: time of its latest access
+    long hist[VIRTUAL_PAGES+1];        // accesses per working-set size
+    long window_faults;                // faults since the last timeline line
+    long releases;                     // ws: frames freed when their page left the window
+    long forced;                       // evictions of a page still in the window
+} ws_t;
+
+// Policy parameters in percent of frames, set from the command line
+static int q2_kin_pct = 25, q2_kout_pct = 50, lirs_hir_pct = 1;
+static int lfu_age_avg = 10;           // lfu-aging: halve counts above this average
+static long ws_tau = 1000;             // ws, wsclock: window in accesses
+
 // Simulation state
 typedef struct {
     alg_t alg;
@@ -83,9 +577,26 @@ typedef struct {
     int frame_pages_cap;               // == frames
     int *frame_page;                   // frame -> page (or -1 if free)
     int *page_to_frame;                // page -> frame (or -1 if not present)
+    uint64_t *free_bits;               // bit f set = frame f is free
+    int free_words;
+    int free_count;                    // 0 = memory full, no search at all
+    int free_hint;                     // lowest word that may have a free bit
     int next_fifo;                     // for FIFO round-robin index
-    int *lru_age;                      // per frame: last used timestamp
-    int time;                          // logical time for LRU
+    long *lru_age;                     // per frame: last used timestamp (lru-scan, wsclock)
+    dlist_t lru;                       // frames by recency, tail = LRU victim (lru, ws)
+    const int *next_use;               // OPT: per access, next use of the same page
+    int *opt_key;                      // OPT: per frame, next use of its page
+    int *opt_heap;                     // OPT: max-heap of frames by opt_key
+    int *opt_pos;                      // OPT: frame -> heap index (or -1)
+    int opt_size;
+    unsigned char *ref;                // CLOCK family: reference bit / GCLOCK counter per frame
+    int hand;                          // clock, gclock, wsclock: next frame to inspect
+    dlist_t sc;                        // second-chance: FIFO queue, tail = oldest
+    arc_t arc;                         // arc, car, 2q
+    lirs_t lirs;                       // lirs
+    lfu_t lfu;                         // lfu, lfu-aging
+    ws_t ws;                           // ws, wsclock
+    long time;                         // logical time for LRU, virtual time for ws/wsclock
 
     // Stats
     long total_accesses;
@@ -100,10 +611,56 @@ static void sim_init(sim_t *s, alg_t alg, int frames){
     s->frame_pages_cap = frames;
     s->frame_page = (int*)malloc(sizeof(int)*frames);
     s->page_to_frame = (int*)malloc(sizeof(int)*VIRTUAL_PAGES);
-    s->lru_age = (int*)malloc(sizeof(int)*frames);
+    s->lru_age = (long*)malloc(sizeof(long)*frames);
     if(!s->frame_page || !s->page_to_frame || !s->lru_age){ perror("malloc"); exit(1);} 
     for(int f=0; f<frames; ++f){ s->frame_page[f] = -1; s->lru_age[f]=0; }
     for(int p=0; p<VIRTUAL_PAGES; ++p){ s->page_to_frame[p] = -1; }
+    s->free_words = (frames + 63) / 64;
+    s->free_bits = (uint64_t*)malloc(sizeof(uint64_t)*s->free_words);
+    if(!s->free_bits){ perror("malloc"); exit(1); }
+    for(int w=0; w<s->free_words; ++w) s->free_bits[w] = ~(uint64_t)0;
+    if(frames % 64) s->free_bits[s->free_words-1] = ((uint64_t)1 << (frames % 64)) - 1;
+    s->free_count = frames;
+    s->free_hint = 0;
+    dlist_init(&s->lru, frames);
+    s->next_use = NULL;
+    s->opt_key = (int*)malloc(sizeof(int)*frames);
+    s->opt_heap = (int*)malloc(sizeof(int)*frames);
+    s->opt_pos = (int*)malloc(sizeof(int)*frames);
+    if(!s->opt_key || !s->opt_heap || !s->opt_pos){ perror("malloc"); exit(1); }
+    for(int f=0; f<frames; ++f){ s->opt_pos[f] = -1; }
+    s->opt_size = 0;
+    s->ref = (unsigned char*)calloc((size_t)frames, 1);
+    if(!s->ref){ perror("calloc"); exit(1); }
+    s->hand = 0;
+    dlist_init(&s->sc, frames);
+    dlist_init(&s->arc.t1, VIRTUAL_PAGES); dlist_init(&s->arc.t2, VIRTUAL_PAGES);
+    dlist_init(&s->arc.b1, VIRTUAL_PAGES); dlist_init(&s->arc.b2, VIRTUAL_PAGES);
+    memset(s->arc.where, ARC_NONE, sizeof(s->arc.where)); memset(s->arc.ref, 0, sizeof(s->arc.ref));
+    s->arc.p = 0; s->arc.b1_hits = s->arc.b2_hits = 0;
+    s->arc.kin = imax(1, (int)((long)frames * q2_kin_pct / 100));
+    s->arc.kout = imax(1, (int)((long)frames * q2_kout_pct / 100));
+    s->arc.a1in_hits = s->arc.am_hits = 0;
+    dlist_init(&s->lirs.s, VIRTUAL_PAGES); dlist_init(&s->lirs.q, VIRTUAL_PAGES);
+    memset(s->lirs.state, LIRS_NONE, sizeof(s->lirs.state));
+    s->lirs.lir_count = 0;
+    s->lirs.lir_max = frames < 2 ? 1 : frames - imax(1, (int)((long)frames * lirs_hir_pct / 100));
+    if(s->lirs.lir_max < 1) s->lirs.lir_max = 1;
+    s->lirs.lir_hits = s->lirs.hir_hits = s->lirs.promotions = 0;
+    lfu_t *u = &s->lfu;
+    int nb = frames + 1;               // one spare: a bucket is created before the old one empties
+    u->bucket = (int*)malloc(sizeof(int)*frames); u->iprev = (int*)malloc(sizeof(int)*frames); u->inext = (int*)malloc(sizeof(int)*frames);
+    u->bcount = (long*)malloc(sizeof(long)*nb); u->bhead = (int*)malloc(sizeof(int)*nb); u->btail = (int*)malloc(sizeof(int)*nb);
+    u->bsize = (int*)malloc(sizeof(int)*nb); u->bprev = (int*)malloc(sizeof(int)*nb); u->bnext = (int*)malloc(sizeof(int)*nb);
+    u->bfree = (int*)malloc(sizeof(int)*nb);
+    if(!u->bucket || !u->iprev || !u->inext || !u->bcount || !u->bhead || !u->btail || !u->bsize || !u->bprev || !u->bnext || !u->bfree){ perror("malloc"); exit(1); }
+    for(int f=0; f<frames; ++f) u->bucket[f] = -1;
+    for(int b=0; b<nb; ++b) u->bfree[b] = nb-1-b;
+    u->nfree = nb; u->first = -1;
+    u->sum = 0; u->resident = 0; u->evictions = u->evicted_sum = 0; u->agings = 0;
+    dlist_init(&s->ws.pages, VIRTUAL_PAGES);
+    memset(s->ws.last, 0, sizeof(s->ws.last)); memset(s->ws.hist, 0, sizeof(s->ws.hist));
+    s->ws.window_faults = s->ws.releases = s->ws.forced = 0;
     s->next_fifo = 0;
     s->time = 0;
     s->total_accesses = s->hits = s->faults = s->replacements = 0;
@@ -113,11 +670,47 @@ static void sim_free(sim_t *s){
     free(s->frame_page); s->frame_page=NULL;
     free(s->page_to_frame); s->page_to_frame=NULL;
     free(s->lru_age); s->lru_age=NULL;
+    free(s->free_bits); s->free_bits=NULL;
+    dlist_free(&s->lru);
+    free(s->opt_key); free(s->opt_heap); free(s->opt_pos); s->opt_key=s->opt_heap=s->opt_pos=NULL;
+    free(s->ref); s->ref=NULL;
+    dlist_free(&s->sc);
+    dlist_free(&s->arc.t1); dlist_free(&s->arc.t2); dlist_free(&s->arc.b1); dlist_free(&s->arc.b2);
+    dlist_free(&s->lirs.s); dlist_free(&s->lirs.q);
+    lfu_t *u = &s->lfu;
+    free(u->bucket); free(u->iprev); free(u->inext); free(u->bcount); free(u->bhead); free(u->btail);
+    free(u->bsize); free(u->bprev); free(u->bnext); free(u->bfree);
+    memset(u, 0, sizeof(*u));
+    dlist_free(&s->ws.pages);
+}
+
+static int ctz64(uint64_t x){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0; while(!(x & 1)){ x >>= 1; n++; } return n;
+#endif
+}
+
+// Takes the lowest-numbered free frame (or -1 when memory is full)
+static int take_free_frame(sim_t *s){
+    if(s->free_count == 0) return -1;
+    int w = s->free_hint;
+    while(s->free_bits[w] == 0) w++;
+    s->free_hint = w;
+    int f = w*64 + ctz64(s->free_bits[w]);
+    s->free_bits[w] &= s->free_bits[w] - 1;
+    s->free_count--;
+    return f;
 }
 
-static int find_free_frame(sim_t *s){
-    for(int f=0; f<s->frames; ++f) if(s->frame_page[f]==-1) return f;
-    return -1;
+// Returns frame f to the free set; its page is no longer mapped
+static void release_frame(sim_t *s, int f){
+    s->page_to_frame[s->frame_page[f]] = -1;
+    s->frame_page[f] = -1;
+    s->free_bits[f/64] |= (uint64_t)1 << (f%64);
+    s->free_count++;
+    if(f/64 < s->free_hint) s->free_hint = f/64;
 }
 
 static int choose_victim_fifo(sim_t *s){
@@ -125,138 +718,958 @@ static int choose_victim_fifo(sim_t *s){
 }
 
 static int choose_victim_lru(sim_t *s){
+    // Least recently used frame sits at the tail of the recency list
+    return s->lru.tail;
+}
+
+static int choose_victim_lru_scan(sim_t *s){
     // Evict the frame with the smallest last-used timestamp
-    int victim = 0; int best_age = s->lru_age[0];
+    int victim = 0; long best_age = s->lru_age[0];
     for(int f=1; f<s->frames; ++f){ if(s->lru_age[f] < best_age){ best_age = s->lru_age[f]; victim = f; } }
     return victim;
 }
 
-static int choose_victim_optimal(sim_t *s, future_list_t future[VIRTUAL_PAGES]){
+// OPT heap order: later next use first; among pages never used again the
+// lowest frame wins, as in a front-to-back scan of the frames
+static bool opt_above(const sim_t *s, int a, int b){
+    return s->opt_key[a] > s->opt_key[b] || (s->opt_key[a]==s->opt_key[b] && a < b);
+}
+static void opt_place(sim_t *s, int i, int f){ s->opt_heap[i] = f; s->opt_pos[f] = i; }
+static void opt_sift_up(sim_t *s, int i){
+    int f = s->opt_heap[i];
+    while(i>0){ int up = (i-1)/2; if(!opt_above(s, f, s->opt_heap[up])) break; opt_place(s, i, s->opt_heap[up]); i = up; }
+    opt_place(s, i, f);
+}
+static void opt_sift_down(sim_t *s, int i){
+    int f = s->opt_heap[i];
+    for(;;){
+        int c = 2*i+1; if(c >= s->opt_size) break;
+        if(c+1 < s->opt_size && opt_above(s, s->opt_heap[c+1], s->opt_heap[c])) c++;
+        if(!opt_above(s, s->opt_heap[c], f)) break;
+        opt_place(s, i, s->opt_heap[c]); i = c;
+    }
+    opt_place(s, i, f);
+}
+// Set frame f's next use to key, inserting it into the heap if needed
+static void opt_update(sim_t *s, int f, int key){
+    if(s->opt_pos[f]==-1){ s->opt_key[f] = key; opt_place(s, s->opt_size++, f); opt_sift_up(s, s->opt_pos[f]); return; }
+    int old = s->opt_key[f]; s->opt_key[f] = key;
+    if(key > old) opt_sift_up(s, s->opt_pos[f]); else opt_sift_down(s, s->opt_pos[f]);
+}
+
+static int choose_victim_optimal(sim_t *s){
     // Evict the page whose next use is farthest in the future (or never used again)
-    int victim_f = 0; int victim_next = -1; // -1 means never used again (best)
-    for(int f=0; f<s->frames; ++f){
-        int p = s->frame_page[f];
-        int nextpos;
-        if(future[p].ptr < future[p].pos.size){
-            nextpos = future[p].pos.data[ future[p].ptr ];
+    return s->opt_heap[0];
+}
+
+static int choose_victim_clock(sim_t *s){
+    // Clear reference bits until the hand finds an unreferenced frame
+    while(s->ref[s->hand]){ s->ref[s->hand] = 0; s->hand = (s->hand + 1) % s->frames; }
+    int v = s->hand; s->hand = (s->hand + 1) % s->frames; return v;
+}
+
+static int choose_victim_second_chance(sim_t *s){
+    // Oldest page is evicted unless referenced; then it is re-queued as new
+    for(;;){
+        int f = s->sc.tail;
+        if(!s->ref[f]){ dlist_unlink(&s->sc, f); return f; }
+        s->ref[f] = 0; dlist_move_front(&s->sc, f);
+    }
+}
+
+static int choose_victim_gclock(sim_t *s){
+    // Like CLOCK, but a frame survives as many sweeps as its counter
+    while(s->ref[s->hand]){ s->ref[s->hand]--; s->hand = (s->hand + 1) % s->frames; }
+    int v = s->hand; s->hand = (s->hand + 1) % s->frames; return v;
+}
+
+static int choose_victim_wsclock(sim_t *s){
+    // A referenced frame gets a fresh stamp and is kept; the first frame not
+    // used for more than tau accesses is evicted. If a full turn finds none,
+    // the whole memory is working set: take the one with the oldest stamp.
+    int oldest = s->hand;
+    for(int k=0; k<s->frames; ++k){
+        int f = s->hand; s->hand = (s->hand + 1) % s->frames;
+        if(s->ref[f]){ s->ref[f] = 0; s->lru_age[f] = s->time; }
+        else if(s->time - s->lru_age[f] > ws_tau) return f;
+        if(s->lru_age[f] < s->lru_age[oldest]) oldest = f;
+    }
+    s->ws.forced++;
+    s->hand = (oldest + 1) % s->frames;
+    return oldest;
+}
+
+// ARC/CAR list helpers: move page to the front of list l (tagged w)
+static dlist_t *arc_list(arc_t *a, int w){
+    switch(w){ case ARC_T1: return &a->t1; case ARC_T2: return &a->t2; case ARC_B1: return &a->b1; default: return &a->b2; }
+}
+static void arc_move(arc_t *a, int page, int w){
+    if(a->where[page]!=ARC_NONE) dlist_unlink(arc_list(a, a->where[page]), page);
+    dlist_push_front(arc_list(a, w), page);
+    a->where[page] = (unsigned char)w;
+}
+static void arc_drop_lru(arc_t *a, dlist_t *l){
+    int page = l->tail; dlist_unlink(l, page); a->where[page] = ARC_NONE;
+}
+
+// On a ghost hit, grow (B1) or shrink (B2) the target for T1
+static void arc_adapt(arc_t *a, int w, int c){
+    if(w==ARC_B1){ a->b1_hits++; a->p = imin(c, a->p + imax(a->b2.size / a->b1.size, 1)); }
+    else if(w==ARC_B2){ a->b2_hits++; a->p = imax(0, a->p - imax(a->b1.size / a->b2.size, 1)); }
+}
+
+// ARC REPLACE: evict the LRU page of T1 or T2, whichever is above its target
+static int arc_replace(sim_t *s, bool in_b2){
+    arc_t *a = &s->arc;
+    int v;
+    if(a->t1.size >= 1 && ((in_b2 && a->t1.size == a->p) || a->t1.size > a->p || a->t2.size == 0)){ v = a->t1.tail; arc_move(a, v, ARC_B1); }
+    else { v = a->t2.tail; arc_move(a, v, ARC_B2); }
+    return s->page_to_frame[v];
+}
+
+static int choose_victim_arc(sim_t *s, int page){
+    arc_t *a = &s->arc; int c = s->frames;
+    int w = a->where[page];
+    arc_adapt(a, w, c);
+    if(w==ARC_NONE){
+        if(a->t1.size + a->b1.size == c){
+            if(a->t1.size == c){
+                // T1 alone fills memory: its LRU page goes without a ghost
+                int v = a->t1.tail; arc_drop_lru(a, &a->t1); return s->page_to_frame[v];
+            }
+            arc_drop_lru(a, &a->b1);
+        } else if(a->t1.size + a->t2.size + a->b1.size + a->b2.size == 2*c){
+            arc_drop_lru(a, &a->b2);
+        }
+    }
+    return arc_replace(s, w==ARC_B2);
+}
+
+// CAR: T1 and T2 are clocks whose hand sits at the list tail. A referenced
+// page under the hand gets its bit cleared and moves on (T1 -> T2, T2 -> T2).
+static int choose_victim_car(sim_t *s, int page){
+    arc_t *a = &s->arc; int c = s->frames;
+    int w = a->where[page], v;
+    for(;;){
+        if(a->t1.size >= imax(1, a->p)){
+            v = a->t1.tail;
+            if(!a->ref[v]){ arc_move(a, v, ARC_B1); break; }
+            a->ref[v] = 0; arc_move(a, v, ARC_T2);
         } else {
-            nextpos = INF_NEXT; // never used again
+            v = a->t2.tail;
+            if(!a->ref[v]){ arc_move(a, v, ARC_B2); break; }
+            a->ref[v] = 0; dlist_move_front(&a->t2, v);
+        }
+    }
+    // Keep the ghost directory within 2c entries
+    if(w==ARC_NONE){
+        if(a->t1.size + a->b1.size == c) arc_drop_lru(a, &a->b1);
+        else if(a->t1.size + a->t2.size + a->b1.size + a->b2.size == 2*c) arc_drop_lru(a, &a->b2);
+    }
+    return s->page_to_frame[v];
+}
+
+// 2Q: make room by evicting from A1in while it is over Kin (remembering the
+// page in A1out), otherwise the LRU page of Am. A faulting page that is in
+// A1out must survive the trim: policy_load promotes it out of A1out, which
+// brings A1out back to Kout.
+static int choose_victim_2q(sim_t *s, int page){
+    arc_t *a = &s->arc;
+    int v;
+    if(a->t1.size > a->kin || a->t2.size == 0){
+        v = a->t1.tail; arc_move(a, v, ARC_B1);
+        if(a->b1.size > a->kout && a->where[page] != ARC_B1) arc_drop_lru(a, &a->b1);
+    } else {
+        v = a->t2.tail; arc_drop_lru(a, &a->t2);
+    }
+    return s->page_to_frame[v];
+}
+
+// LIRS: drop HIR entries from the bottom of S until a LIR page is there
+static void lirs_prune(lirs_t *l){
+    while(l->s.size > 0 && l->state[l->s.tail] != LIRS_LIR){
+        int p = l->s.tail; dlist_unlink(&l->s, p);
+        if(l->state[p]==LIRS_NHIR) l->state[p] = LIRS_NONE;
+    }
+}
+// Turns the bottom LIR page of S into a resident HIR page at the end of Q
+static void lirs_demote_bottom(lirs_t *l){
+    int p = l->s.tail; dlist_unlink(&l->s, p);
+    l->state[p] = LIRS_HIR; l->lir_count--;
+    dlist_push_front(&l->q, p);
+    lirs_prune(l);
+}
+static void lirs_make_lir(lirs_t *l, int p){
+    if(dlist_contains(&l->q, p)) dlist_unlink(&l->q, p);
+    l->state[p] = LIRS_LIR; l->lir_count++; l->promotions++;
+    dlist_move_front(&l->s, p);
+    lirs_demote_bottom(l);
+}
+
+static void lirs_hit(sim_t *s, int p){
+    lirs_t *l = &s->lirs;
+    if(l->state[p]==LIRS_LIR){
+        l->lir_hits++;
+        bool bottom = l->s.tail == p;
+        dlist_move_front(&l->s, p);
+        if(bottom) lirs_prune(l);
+    } else if(dlist_contains(&l->s, p)){
+        // Resident HIR with a reuse distance below the oldest LIR page: swap roles
+        l->hir_hits++;
+        lirs_make_lir(l, p);
+    } else {
+        // Resident HIR no longer in S: back on top of S, to the end of Q
+        l->hir_hits++;
+        dlist_push_front(&l->s, p);
+        dlist_move_front(&l->q, p);
+    }
+}
+
+// Evicts the oldest resident HIR page; it stays in S as non-resident if there
+static int choose_victim_lirs(sim_t *s){
+    lirs_t *l = &s->lirs;
+    int v;
+    if(l->q.size > 0){
+        v = l->q.tail; dlist_unlink(&l->q, v);
+        l->state[v] = dlist_contains(&l->s, v) ? LIRS_NHIR : LIRS_NONE;
+    } else {
+        // Only LIR pages resident (tiny memories): evict the bottom of S
+        v = l->s.tail; dlist_unlink(&l->s, v);
+        l->state[v] = LIRS_NONE; l->lir_count--;
+        lirs_prune(l);
+    }
+    return s->page_to_frame[v];
+}
+
+static void lirs_load(sim_t *s, int p){
+    lirs_t *l = &s->lirs;
+    if(l->state[p]==LIRS_NHIR){
+        // Refault while still in S: short reuse distance, becomes LIR
+        l->lir_count++; l->state[p] = LIRS_LIR; l->promotions++;
+        dlist_move_front(&l->s, p);
+        if(l->lir_count > l->lir_max) lirs_demote_bottom(l);
+    } else if(l->lir_count < l->lir_max){
+        l->state[p] = LIRS_LIR; l->lir_count++;
+        dlist_push_front(&l->s, p);
+    } else {
+        l->state[p] = LIRS_HIR;
+        dlist_push_front(&l->s, p);
+        dlist_push_front(&l->q, p);
+    }
+}
+
+// LFU buckets. New bucket with the given count, linked after bucket `after`
+// (-1 = at the front of the list)
+static int lfu_bucket_new(lfu_t *u, long count, int after){
+    int b = u->bfree[--u->nfree];
+    u->bcount[b] = count; u->bhead[b] = u->btail[b] = -1; u->bsize[b] = 0;
+    u->bprev[b] = after;
+    u->bnext[b] = after==-1 ? u->first : u->bnext[after];
+    if(u->bnext[b]!=-1) u->bprev[u->bnext[b]] = b;
+    if(after==-1) u->first = b; else u->bnext[after] = b;
+    return b;
+}
+static void lfu_bucket_del(lfu_t *u, int b){
+    if(u->bprev[b]!=-1) u->bnext[u->bprev[b]] = u->bnext[b]; else u->first = u->bnext[b];
+    if(u->bnext[b]!=-1) u->bprev[u->bnext[b]] = u->bprev[b];
+    u->bfree[u->nfree++] = b;
+}
+static void lfu_push(lfu_t *u, int f, int b){
+    u->bucket[f] = b; u->iprev[f] = -1; u->inext[f] = u->bhead[b];
+    if(u->bhead[b]!=-1) u->iprev[u->bhead[b]] = f; else u->btail[b] = f;
+    u->bhead[b] = f; u->bsize[b]++;
+}
+// Removes frame f from its bucket, dropping the bucket if it empties
+static void lfu_unlink(lfu_t *u, int f){
+    int b = u->bucket[f];
+    if(u->iprev[f]!=-1) u->inext[u->iprev[f]] = u->inext[f]; else u->bhead[b] = u->inext[f];
+    if(u->inext[f]!=-1) u->iprev[u->inext[f]] = u->iprev[f]; else u->btail[b] = u->iprev[f];
+    u->bucket[f] = -1;
+    if(--u->bsize[b]==0) lfu_bucket_del(u, b);
+}
+
+static void lfu_load(lfu_t *u, int f){
+    int b = u->first;
+    if(b==-1 || u->bcount[b]!=1) b = lfu_bucket_new(u, 1, -1);
+    lfu_push(u, f, b);
+    u->sum++; u->resident++;
+}
+
+// Aging: halve every count (rounding up, so counts stay >= 1). Halving keeps
+// the order, so equal results are merged into the lower bucket in one walk;
+// frames from the merged (higher) bucket go in front, so the lower original
+// counts are still evicted first. O(frames), but it cannot happen again
+// before another resident*avg/2 hits.
+static void lfu_age(lfu_t *u){
+    u->agings++; u->sum = 0;
+    for(int b=u->first; b!=-1; b=u->bnext[b]){
+        u->bcount[b] = (u->bcount[b] + 1) / 2;
+        int nb;
+        while((nb = u->bnext[b])!=-1 && (u->bcount[nb] + 1) / 2 == u->bcount[b]){
+            // Move nb's frames to the front of b, keeping their order
+            for(int f=u->btail[nb]; f!=-1; ){
+                int pv = u->iprev[f];
+                lfu_push(u, f, b);
+                f = pv;
+            }
+            lfu_bucket_del(u, nb);
+        }
+        u->sum += u->bcount[b] * u->bsize[b];
+    }
+}
+
+static void lfu_hit(lfu_t *u, int f, bool aging){
+    int b = u->bucket[f], nb = u->bnext[b];
+    if(nb==-1 || u->bcount[nb]!=u->bcount[b]+1) nb = lfu_bucket_new(u, u->bcount[b]+1, b);
+    lfu_unlink(u, f);
+    lfu_push(u, f, nb);
+    u->sum++;
+    if(aging && u->sum > (long)lfu_age_avg * u->resident) lfu_age(u);
+}
+
+static int choose_victim_lfu(sim_t *s){
+    lfu_t *u = &s->lfu;
+    int b = u->first, f = u->btail[b];
+    u->evictions++; u->evicted_sum += u->bcount[b];
+    u->sum -= u->bcount[b]; u->resident--;
+    lfu_unlink(u, f);
+    return f;
+}
+
+// Policy hooks, dispatched on s->alg
+
+static void policy_hit(sim_t *s, int f, long i){
+    switch(s->alg){
+        case ALG_LRU: case ALG_WS: dlist_move_front(&s->lru, f); break;
+        case ALG_LRU_SCAN: s->lru_age[f] = s->time; break;
+        case ALG_OPTIMAL: opt_update(s, f, s->next_use[i]); break;
+        case ALG_CLOCK: case ALG_SECOND_CHANCE: case ALG_WSCLOCK: s->ref[f] = 1; break;
+        case ALG_GCLOCK: if(s->ref[f] < GCLOCK_MAX) s->ref[f]++; break;
+        case ALG_ARC: arc_move(&s->arc, s->frame_page[f], ARC_T2); break;
+        case ALG_CAR: s->arc.ref[s->frame_page[f]] = 1; break;
+        case ALG_LIRS: lirs_hit(s, s->frame_page[f]); break;
+        case ALG_LFU: case ALG_LFU_AGING: lfu_hit(&s->lfu, f, s->alg == ALG_LFU_AGING); break;
+        case ALG_2Q: {
+            int page = s->frame_page[f];
+            if(s->arc.where[page]==ARC_T2){ s->arc.am_hits++; dlist_move_front(&s->arc.t2, page); }
+            else s->arc.a1in_hits++;   // A1in is FIFO: no reordering
+            break;
+        }
+        default: break;
+    }
+}
+
+// Frame whose page is evicted to make room for page; called only when memory is full
+static int policy_victim(sim_t *s, int page){
+    switch(s->alg){
+        case ALG_LRU: { int f = choose_victim_lru(s); dlist_unlink(&s->lru, f); return f; }
+        case ALG_LRU_SCAN: return choose_victim_lru_scan(s);
+        case ALG_OPTIMAL: return choose_victim_optimal(s);
+        case ALG_CLOCK: return choose_victim_clock(s);
+        case ALG_SECOND_CHANCE: return choose_victim_second_chance(s);
+        case ALG_GCLOCK: return choose_victim_gclock(s);
+        case ALG_ARC: return choose_victim_arc(s, page);
+        case ALG_CAR: return choose_victim_car(s, page);
+        case ALG_LIRS: return choose_victim_lirs(s);
+        case ALG_2Q: return choose_victim_2q(s, page);
+        case ALG_LFU: case ALG_LFU_AGING: return choose_victim_lfu(s);
+        case ALG_WS: { int f = s->lru.tail; dlist_unlink(&s->lru, f); s->ws.forced++; return f; }
+        case ALG_WSCLOCK: return choose_victim_wsclock(s);
+        default: return choose_victim_fifo(s);
+    }
+}
+
+// Page has just been placed in frame f (free or freshly evicted)
+static void policy_load(sim_t *s, int f, long i){
+    switch(s->alg){
+        case ALG_LRU: case ALG_WS: dlist_push_front(&s->lru, f); break;
+        case ALG_LRU_SCAN: s->lru_age[f] = s->time; break;
+        case ALG_WSCLOCK: s->ref[f] = 0; s->lru_age[f] = s->time; break;
+        case ALG_OPTIMAL: opt_update(s, f, s->next_use[i]); break;
+        case ALG_CLOCK: s->ref[f] = 1; break;
+        case ALG_SECOND_CHANCE: s->ref[f] = 1; dlist_push_front(&s->sc, f); break;
+        case ALG_GCLOCK: s->ref[f] = GCLOCK_INIT; break;
+        case ALG_ARC: case ALG_CAR: {
+            // A ghost hit goes to T2 (car adapts p here, arc already did)
+            int page = s->frame_page[f], w = s->arc.where[page];
+            if(s->alg == ALG_CAR) arc_adapt(&s->arc, w, s->frames);
+            arc_move(&s->arc, page, w==ARC_B1 || w==ARC_B2 ? ARC_T2 : ARC_T1);
+            s->arc.ref[page] = 0;
+            break;
         }
-        if(nextpos==INF_NEXT){ return f; } // perfect victim
-        if(nextpos > victim_next){ victim_next = nextpos; victim_f = f; }
+        case ALG_LIRS: lirs_load(s, s->frame_page[f]); break;
+        case ALG_LFU: case ALG_LFU_AGING: lfu_load(&s->lfu, f); break;
+        case ALG_2Q: {
+            // Remembered in A1out: promote to Am; otherwise admit to A1in
+            int page = s->frame_page[f];
+            if(s->arc.where[page]==ARC_B1){ s->arc.b1_hits++; arc_move(&s->arc, page, ARC_T2); }
+            else arc_move(&s->arc, page, ARC_T1);
+            break;
+        }
+        default: break;
     }
-    return victim_f;
+}
+
+// Per-access log. Lines are formatted by hand into a large buffer that is
+// written with fwrite; printf per access dominated the run time otherwise.
+typedef enum { OUT_SUMMARY, OUT_FAULTS, OUT_FULL } out_level_t;
+static out_level_t out_level = OUT_FULL;
+
+#define OUT_LINE_MAX 128
+static char out_buf[1<<20];
+static size_t out_len;
+
+static void out_flush(void){ fwrite(out_buf, 1, out_len, stdout); out_len = 0; }
+static char *out_begin(void){ if(out_len > sizeof(out_buf) - OUT_LINE_MAX) out_flush(); return out_buf + out_len; }
+static void out_end(char *p){ out_len = (size_t)(p - out_buf); }
+
+#define PUT_LIT(p, lit) (memcpy((p), (lit), sizeof(lit)-1), (p) + sizeof(lit)-1)
+
+// Decimal, right-aligned in at least width columns (like %*d for v >= 0)
+static char *put_uint(char *p, unsigned v, int width){
+    char tmp[10]; int n = 0;
+    do { tmp[n++] = (char)('0' + v%10); v /= 10; } while(v);
+    while(width-- > n) *p++ = ' ';
+    while(n) *p++ = tmp[--n];
+    return p;
+}
+// "0x%04X"
+static char *put_addr(char *p, uint16_t a){
+    static const char hex[] = "0123456789ABCDEF";
+    p[0]='0'; p[1]='x'; p[2]=hex[a>>12]; p[3]=hex[(a>>8)&15]; p[4]=hex[(a>>4)&15]; p[5]=hex[a&15];
+    return p + 6;
+}
+static char *put_access(char *p, uint16_t addr, int page){
+    p = PUT_LIT(p, "Access "); p = put_addr(p, addr);
+    p = PUT_LIT(p, " (page "); p = put_uint(p, (unsigned)page, 3);
+    return PUT_LIT(p, "): ");
 }
 
 static void print_hit(uint16_t addr, int page, int frame){
-    printf("Access 0x%04X (page %3d): HIT  -> frame %d\n", addr, page, frame);
+    if(out_level < OUT_FULL) return;
+    char *p = put_access(out_begin(), addr, page);
+    p = PUT_LIT(p, "HIT  -> frame "); p = put_uint(p, (unsigned)frame, 0); *p++ = '\n';
+    out_end(p);
 }
 
 static void print_fault_loaded(uint16_t addr, int page, int frame){
-    printf("Access 0x%04X (page %3d): FAULT -> page in -> frame %d\n", addr, page, frame);
+    if(out_level < OUT_FAULTS) return;
+    char *p = put_access(out_begin(), addr, page);
+    p = PUT_LIT(p, "FAULT -> page in -> frame "); p = put_uint(p, (unsigned)frame, 0); *p++ = '\n';
+    out_end(p);
 }
 
 static void print_fault_replaced(uint16_t addr, int page_in, int victim_page, int victim_frame){
-    printf("Access 0x%04X (page %3d): FAULT -> REPLACE: page %d out (frame %d), page %d in\n",
-           addr, page_in, victim_page, victim_frame, page_in);
-}
-
-static void simulate(sim_t *s, const ivec_t *trace_pages, const ivec_t *trace_addrs, future_list_t future[VIRTUAL_PAGES]){
-    for(int i=0; i<trace_pages->size; ++i){
-        int page = trace_pages->data[i];
-        uint16_t addr = (uint16_t)trace_addrs->data[i];
-        s->total_accesses++;
-        s->time++;
-
-        int frame = s->page_to_frame[page];
-        if(frame != -1){
-            // HIT
-            s->hits++;
-            if(s->alg == ALG_LRU){ s->lru_age[frame] = s->time; }
-            print_hit(addr, page, frame);
+    if(out_level < OUT_FAULTS) return;
+    char *p = put_access(out_begin(), addr, page_in);
+    p = PUT_LIT(p, "FAULT -> REPLACE: page "); p = put_uint(p, (unsigned)victim_page, 0);
+    p = PUT_LIT(p, " out (frame "); p = put_uint(p, (unsigned)victim_frame, 0);
+    p = PUT_LIT(p, "), page "); p = put_uint(p, (unsigned)page_in, 0);
+    p = PUT_LIT(p, " in\n");
+    out_end(p);
+}
+
+static void print_ws_release(int page, int frame){
+    if(out_level < OUT_FAULTS) return;
+    char *p = PUT_LIT(out_begin(), "Window: page "); p = put_uint(p, (unsigned)page, 3);
+    p = PUT_LIT(p, " left the working set -> frame "); p = put_uint(p, (unsigned)frame, 0);
+    p = PUT_LIT(p, " freed\n");
+    out_end(p);
+}
+
+static void print_ws_timeline(long t, int size, long faults){
+    if(out_level < OUT_FAULTS) return;
+    char *p = out_begin();
+    out_end(p + snprintf(p, OUT_LINE_MAX, "Window: t=%ld working set %d pages, %ld faults in the last %ld accesses\n", t, size, faults, ws_tau));
+}
+
+// Before access t: drop the pages not used within tau accesses, so what is
+// left is W(t-1), the working set the access is checked against. ws frees
+// their frames (the page may already be gone if memory was full).
+static void ws_begin(sim_t *s){
+    ws_t *w = &s->ws;
+    int p;
+    while((p = w->pages.tail) != -1 && s->time - w->last[p] > ws_tau){
+        dlist_unlink(&w->pages, p);
+        int f = s->page_to_frame[p];
+        if(s->alg == ALG_WS && f != -1){
+            dlist_unlink(&s->lru, f); release_frame(s, f);
+            w->releases++;
+            print_ws_release(p, f);
+        }
+    }
+}
+
+// After access t: record |W(t)|. Only the page used exactly tau accesses
+// ago can still be listed without being in W(t), and it is the tail.
+static void ws_end(sim_t *s, int page, bool fault){
+    ws_t *w = &s->ws;
+    if(dlist_contains(&w->pages, page)) dlist_move_front(&w->pages, page); else dlist_push_front(&w->pages, page);
+    w->last[page] = s->time;
+    int size = w->pages.size;
+    if(s->time - w->last[w->pages.tail] >= ws_tau) size--;
+    w->hist[size]++;
+    if(fault) w->window_faults++;
+    if(s->time % ws_tau == 0){ print_ws_timeline(s->time, size, w->window_faults); w->window_faults = 0; }
+}
+
+// One access; i is its position in the trace (used by OPT's next_use)
+static void sim_access(sim_t *s, long i, uint16_t addr){
+    int page = (addr >> 8) & 0xFF; // 256-byte pages
+    s->total_accesses++;
+    s->time++;
+    bool ws = s->alg == ALG_WS || s->alg == ALG_WSCLOCK;
+    if(ws) ws_begin(s);
+
+    int frame = s->page_to_frame[page];
+    if(frame != -1){
+        // HIT
+        s->hits++;
+        policy_hit(s, frame, i);
+        print_hit(addr, page, frame);
+    } else {
+        // FAULT
+        s->faults++;
+        int freef = take_free_frame(s);
+        if(freef != -1){
+            // Load into a free frame
+            s->frame_page[freef] = page;
+            s->page_to_frame[page] = freef;
+            policy_load(s, freef, i);
+            print_fault_loaded(addr, page, freef);
         } else {
-            // FAULT
-            s->faults++;
-            int freef = find_free_frame(s);
-            if(freef != -1){
-                // Load into a free frame
-                s->frame_page[freef] = page;
-                s->page_to_frame[page] = freef;
-                if(s->alg == ALG_LRU){ s->lru_age[freef] = s->time; }
-                print_fault_loaded(addr, page, freef);
-            } else {
-                // Need replacement
-                int victim_f;
-                if(s->alg == ALG_FIFO) victim_f = choose_victim_fifo(s);
-                else if(s->alg == ALG_LRU) victim_f = choose_victim_lru(s);
-                else /* OPTIMAL */ victim_f = choose_victim_optimal(s, future);
-
-                int victim_page = s->frame_page[victim_f];
-                // page out victim
-                s->page_to_frame[victim_page] = -1;
-                // page in new
-                s->frame_page[victim_f] = page;
-                s->page_to_frame[page] = victim_f;
-                if(s->alg == ALG_LRU){ s->lru_age[victim_f] = s->time; }
-                s->replacements++;
-                print_fault_replaced(addr, page, victim_page, victim_f);
-            }
+            // Need replacement
+            int victim_f = policy_victim(s, page);
+
+            int victim_page = s->frame_page[victim_f];
+            // page out victim
+            s->page_to_frame[victim_page] = -1;
+            // page in new
+            s->frame_page[victim_f] = page;
+            s->page_to_frame[page] = victim_f;
+            policy_load(s, victim_f, i);
+            s->replacements++;
+            print_fault_replaced(addr, page, victim_page, victim_f);
+        }
+    }
+    if(ws) ws_end(s, page, frame == -1);
+}
+
+static void simulate(sim_t *s, const trace_t *trace){
+    for(int i=0; i<trace->size; ++i) sim_access(s, i, trace->addr[i]);
+}
+
+// Simulates while reading; returns false on a read or format error
+static bool simulate_stream(sim_t *s, trace_stream_t *st){
+    static uint16_t chunk[1<<14];
+    int n;
+    while((n = stream_next(st, chunk, (int)(sizeof(chunk)/sizeof(chunk[0])))) > 0)
+        for(int k=0; k<n; ++k) sim_access(s, s->total_accesses, chunk[k]);
+    return n == 0;
+}
+
+// Miss-ratio curves. LRU and OPT both have the inclusion property: an access
+// hits with n frames iff its stack distance (its depth in the policy's
+// priority stack) is <= n. One pass gives the distance histogram and from
+// it the faults for every frame count.
+
+// faults(n) = cold misses + accesses with distance > n, for n = 1..max
+static void curve_from_hist(const long hist[VIRTUAL_PAGES+1], long cold, long *faults, int max){
+    long beyond = 0;
+    for(int d=1; d<=VIRTUAL_PAGES; ++d) beyond += hist[d];
+    for(int n=1; n<=max; ++n){
+        if(n <= VIRTUAL_PAGES) beyond -= hist[n];
+        faults[n] = cold + beyond;
+    }
+}
+
+// Fenwick tree over trace positions; position i holds 1 while access i is
+// the most recent access to its page
+typedef struct { int *t; int n; } fenwick_t;
+
+static void fenwick_init(fenwick_t *f, int n){
+    f->n = n; f->t = (int*)calloc((size_t)n + 1, sizeof(int));
+    if(!f->t){ perror("calloc"); exit(1); }
+}
+static void fenwick_free(fenwick_t *f){ free(f->t); f->t = NULL; }
+static void fenwick_add(fenwick_t *f, int i, int d){ for(++i; i<=f->n; i += i & -i) f->t[i] += d; }
+static int fenwick_sum(const fenwick_t *f, int i){ int r = 0; for(++i; i>0; i -= i & -i) r += f->t[i]; return r; } // [0..i]
+
+// Fills faults[1..max] for LRU; returns the number of distinct pages.
+// The LRU distance is the number of distinct pages touched since the
+// previous access to the same page, itself included.
+static int mrc_lru(const trace_t *t, long *faults, int max){
+    long hist[VIRTUAL_PAGES+1] = {0}, cold = 0;
+    int last[VIRTUAL_PAGES], distinct = 0;
+    for(int p=0;p<VIRTUAL_PAGES;++p) last[p] = -1;
+    fenwick_t fw; fenwick_init(&fw, t->size);
+    for(int i=0;i<t->size;++i){
+        int p = t->addr[i] >> 8;
+        if(last[p] < 0){ cold++; distinct++; }
+        else {
+            hist[fenwick_sum(&fw, i-1) - fenwick_sum(&fw, last[p]) + 1]++;
+            fenwick_add(&fw, last[p], -1);
+        }
+        fenwick_add(&fw, i, 1);
+        last[p] = i;
+    }
+    fenwick_free(&fw);
+    curve_from_hist(hist, cold, faults, max);
+    return distinct;
+}
+
+// Same for OPT, built on next_use. The stack is ordered so that its top n
+// entries are exactly what OPT keeps with n frames. On an access the page
+// moves to the top and the displaced entries are pushed down one level at a
+// time: at each level the page with the later next use (the one OPT would
+// evict from that many frames) continues downward, the other stays.
+static int mrc_optimal(const trace_t *t, const int *next_use, long *faults, int max){
+    long hist[VIRTUAL_PAGES+1] = {0}, cold = 0;
+    int stack[VIRTUAL_PAGES], depth = 0;
+    int nu[VIRTUAL_PAGES];   // per page: next use after its latest access
+    for(int i=0;i<t->size;++i){
+        int p = t->addr[i] >> 8;
+        nu[p] = next_use[i];
+        if(depth==0){ stack[depth++] = p; cold++; continue; }
+        int y = stack[0]; stack[0] = p;
+        if(y==p){ hist[1]++; continue; }
+        int k = 1;
+        for(; k<depth && stack[k]!=p; ++k){
+            int z = stack[k];
+            if(nu[z] > nu[y]){ stack[k] = y; y = z; }
+        }
+        if(k<depth){ stack[k] = y; hist[k+1]++; }
+        else { stack[depth++] = y; cold++; }
+    }
+    curve_from_hist(hist, cold, faults, max);
+    return depth;
+}
+
+static void print_curve(const char *name, const trace_t *t, int distinct, const long *faults, int max){
+    printf("=== %s miss-ratio curve ===\n", name);
+    printf("Total accesses  : %d\n", t->size);
+    printf("Distinct pages  : %d\n", distinct);
+    printf("%8s %12s %12s %12s %10s\n", "Frames", "Faults", "Hits", "Replacements", "Miss ratio");
+    for(int n=1; n<=max; ++n){
+        long loads = n < distinct ? n : distinct;
+        printf("%8d %12ld %12ld %12ld %10.6f\n", n, faults[n], t->size - faults[n], faults[n] - loads, (double)faults[n] / t->size);
+    }
+}
+
+// Parallel sweep: one independent sim_t per (algorithm, frames) cell over the
+// shared read-only trace. Each worker owns a contiguous block of cells and
+// takes them from the front; when its block is empty it steals from the back
+// of the others' blocks. Cells are never added, so a worker that finds every
+// block empty is done.
+typedef struct { alg_t alg; int frames; long hits, faults, replacements; } sweep_cell_t;
+typedef struct { pthread_mutex_t mtx; int lo, hi; } sweep_deque_t;
+typedef struct {
+    const trace_t *trace;
+    const int *next_use;
+    sweep_cell_t *cells;
+    sweep_deque_t *dq;
+    int workers;
+} sweep_t;
+typedef struct { sweep_t *sw; int id; } sweep_worker_t;
+
+static bool deque_take(sweep_deque_t *d, int *cell, bool front){
+    pthread_mutex_lock(&d->mtx);
+    bool ok = d->lo < d->hi;
+    if(ok) *cell = front ? d->lo++ : --d->hi;
+    pthread_mutex_unlock(&d->mtx);
+    return ok;
+}
+
+static void *sweep_main(void *arg){
+    sweep_worker_t *w = (sweep_worker_t*)arg; sweep_t *sw = w->sw;
+    int c;
+    for(;;){
+        bool got = deque_take(&sw->dq[w->id], &c, true);
+        for(int k=1; !got && k<sw->workers; ++k) got = deque_take(&sw->dq[(w->id+k) % sw->workers], &c, false);
+        if(!got) break;
+        sweep_cell_t *cell = &sw->cells[c];
+        sim_t sim; sim_init(&sim, cell->alg, cell->frames);
+        sim.next_use = sw->next_use;
+        simulate(&sim, sw->trace);
+        cell->hits = sim.hits; cell->faults = sim.faults; cell->replacements = sim.replacements;
+        sim_free(&sim);
+    }
+    return NULL;
+}
+
+static void run_sweep(const trace_t *t, const int *next_use, sweep_cell_t *cells, int ncells, int workers){
+    if(workers > ncells) workers = ncells;
+    sweep_t sw = { t, next_use, cells, (sweep_deque_t*)malloc(sizeof(sweep_deque_t)*workers), workers };
+    sweep_worker_t *wa = (sweep_worker_t*)malloc(sizeof(sweep_worker_t)*workers);
+    pthread_t *tid = (pthread_t*)malloc(sizeof(pthread_t)*workers);
+    if(!sw.dq || !wa || !tid){ perror("malloc"); exit(1); }
+    for(int w=0; w<workers; ++w){
+        pthread_mutex_init(&sw.dq[w].mtx, NULL);
+        sw.dq[w].lo = (int)((long)ncells*w/workers); sw.dq[w].hi = (int)((long)ncells*(w+1)/workers);
+        wa[w].sw = &sw; wa[w].id = w;
+    }
+    int started = 0;
+    for(int w=1; w<workers; ++w){
+        if(pthread_create(&tid[w], NULL, sweep_main, &wa[w])!=0){ perror("pthread_create"); break; }
+        started = w;
+    }
+    sweep_main(&wa[0]);   // the main thread works too (and steals whatever unstarted workers own)
+    for(int w=1; w<=started; ++w) pthread_join(tid[w], NULL);
+    for(int w=0; w<workers; ++w) pthread_mutex_destroy(&sw.dq[w].mtx);
+    free(sw.dq); free(wa); free(tid);
+}
+
+// Frame list "1-64,128,200-256:8" -> values (ranges with optional step);
+// returns the count, 0 if the list is malformed
+static int parse_frame_list(const char *spec, int **out){
+    int n = 0, cap = 16; int *v = (int*)malloc(sizeof(int)*cap);
+    if(!v){ perror("malloc"); exit(1); }
+    const char *p = spec;
+    bool ok = *p != '\0';
+    while(ok && *p){
+        char *e; long lo = strtol(p, &e, 10), hi, step = 1;
+        ok = e != p; p = e; hi = lo;
+        if(ok && *p=='-'){ hi = strtol(p+1, &e, 10); ok = e != p+1; p = e; }
+        if(ok && *p==':'){ step = strtol(p+1, &e, 10); ok = e != p+1; p = e; }
+        ok = ok && lo > 0 && hi >= lo && step > 0 && hi <= INT32_MAX && (*p==',' || *p=='\0');
+        for(long f=lo; ok && f<=hi; f+=step){
+            if(n==cap){ cap *= 2; v = (int*)realloc(v, sizeof(int)*cap); if(!v){ perror("realloc"); exit(1); } }
+            v[n++] = (int)f;
         }
+        if(*p==',') p++;
+    }
+    if(!ok){ free(v); return 0; }
+    *out = v;
+    return n;
+}
+
+static int online_cpus(void){
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+// Maps and decodes a whole text or binary trace; on success the caller
+// releases it with trace_free + unmap_file
+static bool load_trace(const char *path, file_map_t *fm, trace_t *trace, bool timing){
+    if(!map_file(path, fm)){ perror("open trace"); return false; }
 
-        // Advance OPT future pointer for this page (we just consumed index i)
-        if(s->alg == ALG_OPTIMAL){ if(future[page].ptr < future[page].pos.size) future[page].ptr++; }
+    double t0 = now_seconds();
+    bool binary = is_binary_trace(fm);
+    if(!(binary ? load_binary_trace(fm, trace) : load_text_trace(fm, trace))){ trace_free(trace); unmap_file(fm); return false; }
+    double dt = now_seconds() - t0;
+    if(timing){
+        double mb = fm->size / 1e6;
+        fprintf(stderr, "%s %.2f MB (%d addresses) in %.3f s: %.1f MB/s\n", binary? "Loaded binary" : "Parsed",
+                mb, trace->size, dt, dt>0? mb/dt : 0.0);
+    }
+    // A raw binary trace is used in place, so keep the mapping until the end
+    if(trace->addr == trace->own.data){ unmap_file(fm); }
+
+    if(trace->size==0){ fprintf(stderr, "Empty or invalid trace file.\n"); trace_free(trace); unmap_file(fm); return false; }
+    return true;
+}
+
+// Working-set size over all accesses: mean and percentiles, then the share
+// of accesses per size range (at most WS_BINS equal ranges from min to max)
+static void print_ws_distribution(const long hist[VIRTUAL_PAGES+1], long total){
+    double sum = 0; int lo = -1, hi = 0;
+    for(int n=0; n<=VIRTUAL_PAGES; ++n) if(hist[n]){ sum += (double)n * hist[n]; if(lo<0) lo = n; hi = n; }
+    int pct[3] = {0}; const double q[3] = {0.5, 0.9, 0.99};
+    long cum = 0;
+    for(int n=0, k=0; n<=VIRTUAL_PAGES && k<3; ++n){
+        cum += hist[n];
+        while(k<3 && cum >= q[k] * total) pct[k++] = n;
+    }
+    printf("Working set     : mean %.2f, min %d, median %d, p90 %d, p99 %d, max %d pages\n",
+           sum / total, lo, pct[0], pct[1], pct[2], hi);
+    int width = (hi - lo + WS_BINS) / WS_BINS;
+    printf("%9s %12s %8s\n", "Pages", "Accesses", "Share");
+    for(int b=lo; b<=hi; b+=width){
+        int e = imin(b + width - 1, hi);
+        long c = 0;
+        for(int n=b; n<=e; ++n) c += hist[n];
+        if(width==1) printf("%9d", b); else printf("%4d-%-4d", b, e);
+        printf(" %12ld %7.2f%%\n", c, 100.0 * c / total);
     }
 }
 
 static void usage(const char *prog){
     fprintf(stderr,
-        "Usage: %s -a <fifo|lru|optimal> -n <frames> -f <trace file>\n",
-        prog);
+        "Usage: %s -a <algorithm> -n <frames> -f <trace file|-> [-S] [-t] [-o summary|faults|full]\n"
+        "          [-q <kin%%>,<kout%%>] [-l <hir%%>] [-g <avg>] [-T <tau>]\n"
+        "       %s -f <trace file|-> -c <binary out> [-e raw|delta]\n"
+        "       %s -M <lru|optimal> -f <trace file|-> [-n <max frames>]\n"
+        "       %s -w <alg,alg,...|all> -n <frame list> -f <trace file|-> [-j <threads>]\n"
+        "  -S  stream the trace in chunks (constant memory; not with optimal)\n"
+        "  -o  per-access output: summary (none), faults, full (default)\n"
+        "  -M  miss-ratio curve: faults for every frame count 1..max (default %d) in one pass\n"
+        "  -w  sweep all algorithm x frame pairs in parallel, CSV out; frame list like 1-64,128,200-256:8\n"
+        "  -j  sweep threads (default: online CPUs)\n"
+        "  -q  2q queue sizes in %% of frames: A1in,A1out (default 25,50)\n"
+        "  -l  lirs HIR part in %% of frames (default 1)\n"
+        "  -g  lfu-aging: halve all counts when their average exceeds this (>= 2, default 10)\n"
+        "  -T  ws, wsclock: working-set window in accesses (default 1000)\n",
+        prog, prog, prog, prog, VIRTUAL_PAGES);
+    fprintf(stderr, "  algorithms:");
+    for(int a=0; a<NUM_ALGS; ++a) fprintf(stderr, " %s", alg_keys[a]);
+    fprintf(stderr, "\n");
 }
 
 int main(int argc, char **argv){
-    const char *afile=NULL; const char *tracefile=NULL; int nframes=-1; alg_t alg=ALG_FIFO;
+    const char *afile=NULL; const char *tracefile=NULL; const char *nspec=NULL; int nframes=-1; alg_t alg=ALG_FIFO; bool timing=false;
+    const char *convfile=NULL; int enc=TRACE_RAW; bool stream=false; const char *curve=NULL;
+    const char *sweep=NULL; int threads=0;
     for(int i=1;i<argc;i++){
         if(strcmp(argv[i], "-a")==0 && i+1<argc){ afile = argv[++i]; }
-        else if(strcmp(argv[i], "-n")==0 && i+1<argc){ nframes = atoi(argv[++i]); }
+        else if(strcmp(argv[i], "-n")==0 && i+1<argc){ nspec = argv[++i]; nframes = atoi(nspec); }
         else if(strcmp(argv[i], "-f")==0 && i+1<argc){ tracefile = argv[++i]; }
+        else if(strcmp(argv[i], "-t")==0){ timing = true; }
+        else if(strcmp(argv[i], "-S")==0){ stream = true; }
+        else if(strcmp(argv[i], "-o")==0 && i+1<argc){
+            const char *o = argv[++i];
+            if(strcmp(o, "summary")==0) out_level = OUT_SUMMARY; else if(strcmp(o, "faults")==0) out_level = OUT_FAULTS;
+            else if(strcmp(o, "full")==0) out_level = OUT_FULL;
+            else { usage(argv[0]); return 1; }
+        }
+        else if(strcmp(argv[i], "-c")==0 && i+1<argc){ convfile = argv[++i]; }
+        else if(strcmp(argv[i], "-M")==0 && i+1<argc){ curve = argv[++i]; }
+        else if(strcmp(argv[i], "-q")==0 && i+1<argc){
+            if(sscanf(argv[++i], "%d,%d", &q2_kin_pct, &q2_kout_pct)!=2 || q2_kin_pct<0 || q2_kin_pct>100 || q2_kout_pct<0){ usage(argv[0]); return 1; }
+        }
+        else if(strcmp(argv[i], "-g")==0 && i+1<argc){
+            lfu_age_avg = atoi(argv[++i]);
+            if(lfu_age_avg<2){ usage(argv[0]); return 1; }
+        }
+        else if(strcmp(argv[i], "-T")==0 && i+1<argc){
+            ws_tau = atol(argv[++i]);
+            if(ws_tau<1){ usage(argv[0]); return 1; }
+        }
+        else if(strcmp(argv[i], "-l")==0 && i+1<argc){
+            lirs_hir_pct = atoi(argv[++i]);
+            if(lirs_hir_pct<1 || lirs_hir_pct>99){ usage(argv[0]); return 1; }
+        }
+        else if(strcmp(argv[i], "-w")==0 && i+1<argc){ sweep = argv[++i]; }
+        else if(strcmp(argv[i], "-j")==0 && i+1<argc){ threads = atoi(argv[++i]); if(threads<=0){ usage(argv[0]); return 1; } }
+        else if(strcmp(argv[i], "-e")==0 && i+1<argc){
+            const char *e = argv[++i];
+            if(strcmp(e, "raw")==0) enc = TRACE_RAW; else if(strcmp(e, "delta")==0) enc = TRACE_DELTA;
+            else { usage(argv[0]); return 1; }
+        }
         else { usage(argv[0]); return 1; }
     }
-    if(!afile || !tracefile || nframes<=0){ usage(argv[0]); return 1; }
-    if(strcmp(afile, "fifo")==0) alg = ALG_FIFO;
-    else if(strcmp(afile, "lru")==0) alg = ALG_LRU;
-    else if(strcmp(afile, "optimal")==0) alg = ALG_OPTIMAL;
-    else { fprintf(stderr, "Unknown algorithm: %s\n", afile); return 1; }
+    if(sweep){
+        if(!tracefile || !nspec || afile || curve || convfile || stream){ usage(argv[0]); return 1; }
+        bool use[NUM_ALGS] = {false};
+        if(strcmp(sweep, "all")==0){ for(int a=0; a<NUM_ALGS; ++a) use[a] = true; }
+        else {
+            char *list = strdup(sweep);
+            if(!list){ perror("strdup"); return 1; }
+            for(char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")){
+                alg_t a;
+                if(!parse_alg(tok, &a)){ fprintf(stderr, "Unknown algorithm: %s\n", tok); free(list); return 1; }
+                use[a] = true;
+            }
+            free(list);
+        }
+        bool any = false;
+        for(int a=0; a<NUM_ALGS; ++a) any = any || use[a];
+        if(!any){ usage(argv[0]); return 1; }   // e.g. "-w ,": no cells, no workers
+        int *fl; int nf = parse_frame_list(nspec, &fl);
+        if(nf==0){ fprintf(stderr, "Invalid frame list: %s\n", nspec); return 1; }
 
-    // Read trace entirely
-    FILE *fp = fopen(tracefile, "r");
-    if(!fp){ perror("fopen trace"); return 1; }
+        file_map_t fm = { NULL, 0, false };
+        trace_t trace;
+        if(!load_trace(tracefile, &fm, &trace, timing)){ free(fl); return 1; }
+        int *next_use = use[ALG_OPTIMAL] ? build_next_use(&trace) : NULL;
 
-    ivec_t trace_addrs; ivec_t trace_pages; ivec_init(&trace_addrs); ivec_init(&trace_pages);
-    uint16_t addr;
-    while(read_hex_address(fp, &addr)){
-        ivec_push(&trace_addrs, (int)addr);
-        int page = (addr >> 8) & 0xFF; // 256-byte pages
-        ivec_push(&trace_pages, page);
-    }
-    fclose(fp);
+        int ncells = 0;
+        sweep_cell_t *cells = (sweep_cell_t*)malloc(sizeof(sweep_cell_t)*(size_t)NUM_ALGS*nf);
+        if(!cells){ perror("malloc"); return 1; }
+        for(int a=0; a<NUM_ALGS; ++a) if(use[a])
+            for(int k=0; k<nf; ++k){ cells[ncells].alg = (alg_t)a; cells[ncells].frames = fl[k]; ncells++; }
 
-    if(trace_pages.size==0){ fprintf(stderr, "Empty or invalid trace file.\n"); ivec_free(&trace_addrs); ivec_free(&trace_pages); return 1; }
+        out_level = OUT_SUMMARY;   // workers must not touch the shared output buffer
+        double t0 = now_seconds();
+        run_sweep(&trace, next_use, cells, ncells, threads ? threads : online_cpus());
+        double dt = now_seconds() - t0;
+        if(timing) fprintf(stderr, "Swept %d cells in %.3f s\n", ncells, dt);
 
-    // Prepare OPT future lists
-    future_list_t future[VIRTUAL_PAGES];
-    for(int p=0;p<VIRTUAL_PAGES;++p){ ivec_init(&future[p].pos); future[p].ptr = 0; }
-    if(alg == ALG_OPTIMAL){
-        for(int i=0;i<trace_pages.size;++i){ int p = trace_pages.data[i]; ivec_push(&future[p].pos, i); }
+        printf("algorithm,frames,accesses,hits,faults,replacements\n");
+        for(int c=0; c<ncells; ++c)
+            printf("%s,%d,%d,%ld,%ld,%ld\n", alg_keys[cells[c].alg], cells[c].frames, trace.size,
+                   cells[c].hits, cells[c].faults, cells[c].replacements);
+        free(cells); free(next_use); free(fl);
+        trace_free(&trace); unmap_file(&fm);
+        return 0;
+    }
+    if(curve && nframes==-1) nframes = VIRTUAL_PAGES;
+    if(!tracefile || (!convfile && !curve && !afile) || (!convfile && nframes<=0) || (convfile && curve)){ usage(argv[0]); return 1; }
+    if(curve){
+        bool opt = strcmp(curve, "optimal")==0;
+        if(!opt && strcmp(curve, "lru")!=0){ fprintf(stderr, "Unknown curve algorithm: %s\n", curve); return 1; }
+        if(stream){ fprintf(stderr, "-M needs the whole trace (no -S).\n"); return 1; }
+        file_map_t fm = { NULL, 0, false };
+        trace_t trace;
+        if(!load_trace(tracefile, &fm, &trace, timing)) return 1;
+        long *faults = (long*)malloc(sizeof(long)*((size_t)nframes+1));
+        if(!faults){ perror("malloc"); return 1; }
+        int *next_use = opt ? build_next_use(&trace) : NULL;
+        int distinct = opt ? mrc_optimal(&trace, next_use, faults, nframes) : mrc_lru(&trace, faults, nframes);
+        print_curve(opt ? "Optimal" : "LRU", &trace, distinct, faults, nframes);
+        free(next_use); free(faults); trace_free(&trace); unmap_file(&fm);
+        return 0;
     }
+    if(!convfile && !parse_alg(afile, &alg)){ fprintf(stderr, "Unknown algorithm: %s\n", afile); return 1; }
+    if(stream && (convfile || alg == ALG_OPTIMAL)){ fprintf(stderr, "-S needs a policy without lookahead (not optimal, not -c).\n"); return 1; }
+
+    sim_t sim;
+    file_map_t fm = { NULL, 0, false };
+    trace_t trace; avec_init(&trace.own); trace.addr = NULL; trace.size = 0;
+    int *next_use = NULL;
+
+    if(stream){
+        // Read, decode and simulate chunk by chunk
+        trace_stream_t st;
+        if(!stream_open(&st, tracefile)){ if(!st.fp) perror("open trace"); stream_close(&st); return 1; }
+        sim_init(&sim, alg, nframes);
+        double t0 = now_seconds();
+        bool ok = simulate_stream(&sim, &st);
+        double dt = now_seconds() - t0;
+        if(ok && timing){
+            double mb = st.bytes / 1e6;
+            fprintf(stderr, "Streamed %.2f MB (%ld addresses) in %.3f s: %.1f MB/s\n", mb, sim.total_accesses, dt, dt>0? mb/dt : 0.0);
+        }
+        stream_close(&st);
+        if(ok && sim.total_accesses==0){ fprintf(stderr, "Empty or invalid trace file.\n"); ok = false; }
+        if(!ok){ sim_free(&sim); return 1; }
+    } else {
+        // Read trace entirely
+        if(!load_trace(tracefile, &fm, &trace, timing)) return 1;
+
+        if(convfile){
+            bool ok = write_binary_trace(convfile, &trace, enc);
+            if(ok) fprintf(stderr, "Wrote %d addresses to %s (%s)\n", trace.size, convfile, enc==TRACE_RAW? "raw" : "delta");
+            trace_free(&trace); unmap_file(&fm);
+            return ok? 0 : 1;
+        }
+
+        // Prepare OPT next-use table
+        if(alg == ALG_OPTIMAL) next_use = build_next_use(&trace);
 
-    // Init sim
-    sim_t sim; sim_init(&sim, alg, nframes);
+        // Init sim
+        sim_init(&sim, alg, nframes);
+        sim.next_use = next_use;
 
-    // Run
-    simulate(&sim, &trace_pages, &trace_addrs, future);
+        // Run
+        simulate(&sim, &trace);
+    }
 
     // Summary
+    out_flush();
     printf("\n=== Summary ===\n");
     printf("Algorithm       : %s\n", alg_name(alg));
     printf("Frames          : %d (total physical = %d bytes)\n", sim.frames, sim.frames*PAGE_SIZE);
@@ -264,10 +1677,37 @@ int main(int argc, char **argv){
     printf("Page hits       : %ld\n", sim.hits);
     printf("Page faults     : %ld\n", sim.faults);
     printf("Replacements    : %ld\n", sim.replacements);
+    if(alg == ALG_ARC || alg == ALG_CAR){
+        printf("Ghost hits      : %ld (B1 %ld, B2 %ld)\n", sim.arc.b1_hits + sim.arc.b2_hits, sim.arc.b1_hits, sim.arc.b2_hits);
+        printf("Target T1 (p)   : %d of %d\n", sim.arc.p, sim.frames);
+    }
+    if(alg == ALG_2Q){
+        printf("2Q sizes        : Kin %d, Kout %d\n", sim.arc.kin, sim.arc.kout);
+        printf("Hits A1in / Am  : %ld / %ld\n", sim.arc.a1in_hits, sim.arc.am_hits);
+        printf("A1out promotions: %ld\n", sim.arc.b1_hits);
+    }
+    if(alg == ALG_LIRS){
+        printf("LIR capacity    : %d of %d\n", sim.lirs.lir_max, sim.frames);
+        printf("Hits LIR / HIR  : %ld / %ld\n", sim.lirs.lir_hits, sim.lirs.hir_hits);
+        printf("HIR promotions  : %ld\n", sim.lirs.promotions);
+    }
+    if(alg == ALG_LFU || alg == ALG_LFU_AGING){
+        printf("Evicted avg freq: %.2f (%ld evictions)\n", sim.lfu.evictions ? (double)sim.lfu.evicted_sum / sim.lfu.evictions : 0.0, sim.lfu.evictions);
+        if(alg == ALG_LFU_AGING) printf("Agings          : %ld (average count > %d)\n", sim.lfu.agings, lfu_age_avg);
+    }
+    if(alg == ALG_WS || alg == ALG_WSCLOCK){
+        printf("Window (tau)    : %ld accesses\n", ws_tau);
+        printf("Fault rate      : %.6f\n", (double)sim.faults / sim.total_accesses);
+        if(alg == ALG_WS){
+            printf("Window releases : %ld\n", sim.ws.releases);
+            printf("Forced evictions: %ld (working set larger than memory)\n", sim.ws.forced);
+        } else printf("Forced evictions: %ld (no frame outside the window)\n", sim.ws.forced);
+        print_ws_distribution(sim.ws.hist, sim.total_accesses);
+    }
 
     // Cleanup
     sim_free(&sim);
-    for(int p=0;p<VIRTUAL_PAGES;++p) ivec_free(&future[p].pos);
-    ivec_free(&trace_addrs); ivec_free(&trace_pages);
+    free(next_use);
+    trace_free(&trace); unmap_file(&fm);
     return 0;
 }